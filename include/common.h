@@ -40,11 +40,25 @@
 #include <xf86drmMode.h>
 
 // 
+#include "../include/frame.h"               // 帧元数据
+#include "../include/frame_pool.h"          // 物理连续帧池
 #include "../include/v4l2.h"                // 摄像头相关
 #include "../include/show.h"                // 显示相关
 #include "../include/saveVideo.h"           // 视频保存相关
 #include "../include/person_detect_capi.h"  // 识别检测的对外接口C接口
+#include "../include/latency.h"             // 延迟与丢帧统计
+#include "../include/frame_sched.h"         // 帧调度
+#include "../include/thread_policy.h"       // 线程命名、绑核与调度策略
+#include "../include/stream_server.h"       // 实时流服务
+#include "../include/shm_ring.h"            // 共享内存帧/检测结果发布
 
 #define CLEAR(x) memset(&(x), 0, sizeof(x))
 
+// 当前CLOCK_MONOTONIC时间（纳秒）
+static inline int64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 #endif // COMMON_H
@@ -0,0 +1,30 @@
+#ifndef DUAL_CAPTURE_H
+#define DUAL_CAPTURE_H
+
+#include "../include/common.h"
+
+// 双码流采集：全分辨率主码流（显示、录像）+ 小分辨率子码流（检测），
+// 如ISP的两路输出。主循环跟随主码流，子码流帧按采集时间戳与主码流帧配对
+struct dual_capture {
+    struct v4l2_capture* sub;   // 子码流（由调用方初始化）
+    int64_t max_skew_ns;        // 配对允许的最大时间差
+
+    // 当前持有的子码流帧（已出队，未入队）
+    bool held;
+    struct v4l2_buffer sub_buf;
+    struct frame_meta sub_meta;
+
+    // 统计
+    uint64_t paired;            // 配对成功的主码流帧数
+    uint64_t unpaired;          // 没有配上子码流帧的主码流帧数
+    uint64_t sub_dropped;       // 没有用上就被丢弃的子码流帧数
+};
+
+void dual_capture_init(struct dual_capture* dc, struct v4l2_capture* sub, int max_skew_ms);
+// 为主码流帧取时间戳最接近的子码流帧：0 配对成功（sub为其帧描述，用完后调用dual_capture_release），1 没有配对的帧，-1 子码流出错
+int dual_capture_pair(struct dual_capture* dc, const struct frame_meta* main_meta, struct frame_desc* sub);
+int dual_capture_release(struct dual_capture* dc);  // 子码流帧入队，0 成功, -1 失败
+void dual_capture_reset(struct dual_capture* dc);   // 子码流重新初始化后调用（丢弃持有的帧）
+void dual_capture_report(struct dual_capture* dc);
+
+#endif // DUAL_CAPTURE_H
@@ -0,0 +1,44 @@
+#ifndef EPTZ_H
+#define EPTZ_H
+
+#include "../include/common.h"
+
+#define EPTZ_MAX_BOXES 16   // 参与取景和叠加显示的检测框上限
+
+// 电子云台（ePTZ）：在整帧中裁出包含当前行人的区域，缩放到显示屏。
+// 检测线程更新目标，主线程每个显示帧平滑移动取景框并裁剪缩放
+struct eptz {
+    // 配置（eptz_init之前设置）
+    int src_width, src_height;   // 采集帧尺寸
+    int out_width, out_height;   // 显示尺寸（取景框保持这个宽高比）
+    float max_zoom;              // 最大放大倍数（取景框最小宽度 = src_width / max_zoom）
+    float margin;                // 检测框外扩比例（相对检测框并集的尺寸）
+    int smooth_ms;               // 平滑时间常数：取景框每过smooth_ms移动剩余距离的约63%
+    int hold_ms;                 // 最后一次检测到人之后保持取景的时间，超时后回到全景
+    int deadband;                // 目标变化小于该像素数时不跟随（避免检测框抖动引起画面晃动）
+
+    // 检测线程写入，主线程读取
+    pthread_mutex_t lock;
+    struct det_location boxes[EPTZ_MAX_BOXES];   // 最新检测框（采集帧坐标）
+    int box_count;
+    int64_t last_seen_ns;        // 最后一次检测到人的时间
+    bool boxes_changed;          // 有新结果，叠加层需要重画
+
+    // 取景状态（只在主线程使用）
+    float cx, cy, w;             // 当前取景框中心和宽度（高度按显示宽高比）
+    float tcx, tcy, tw;          // 目标取景框
+    int64_t last_step_ns;
+    int crop_x, crop_y, crop_w, crop_h;   // 本帧取景框（偶数对齐，位于帧内）
+    int drawn_x, drawn_y, drawn_w;        // 叠加层上次重画时的取景框
+    int drawn_count;                      // 叠加层上现有的框数
+};
+
+void eptz_init(struct eptz* ez);
+void eptz_destroy(struct eptz* ez);
+void eptz_update_detections(struct eptz* ez, const struct all_det_location* all_loc);  // 检测线程调用
+// 主线程每个显示帧调用：推进取景框，返回本帧的裁剪区域；叠加层需要重画时*redraw为true
+struct frame_desc eptz_step(struct eptz* ez, const struct frame_desc* src, bool* redraw);
+// 把最新检测框映射到显示坐标（裁掉取景框外的部分），返回框数
+int eptz_map_boxes(struct eptz* ez, struct det_location* out, int max);
+
+#endif // EPTZ_H
@@ -0,0 +1,83 @@
+#ifndef EVENT_INDEX_H
+#define EVENT_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+* 录像事件索引（与分段同名，后缀.idx）
+* 文件头 + 定长记录，只追加写；记录按pts_ms非递减排列，mmap后可直接二分查找
+* 不依赖FFmpeg，查询工具（tools/evquery.c）可以单独编译
+*/
+#define EVENT_INDEX_SUFFIX  ".idx"
+#define EVENT_INDEX_MAGIC   "K230EVIX"
+#define EVENT_INDEX_VERSION 1
+
+enum event_record_type {
+    EVENT_KEYFRAME = 1,   // 关键帧：offset为该关键帧所在分片（moof）在录像文件中的偏移
+    EVENT_DETECT   = 2,   // 检测汇总：[pts_ms - duration_ms, pts_ms] 区间内的检测结果
+};
+
+struct event_index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    int64_t start_realtime_ms;  // 分段开始的墙上时间（pts_ms = 0 对应的时刻）
+    uint32_t interval_ms;       // 检测汇总周期
+    uint32_t reserved;
+};
+
+struct event_index_record {
+    int64_t pts_ms;         // 分段内时间（毫秒）
+    uint64_t offset;        // EVENT_KEYFRAME: 文件偏移
+    uint8_t type;           // enum event_record_type
+    uint8_t count;          // EVENT_DETECT: 区间内单帧最多人数
+    uint16_t max_score;     // EVENT_DETECT: 最高得分 * 1000
+    uint16_t duration_ms;   // EVENT_DETECT: 区间长度
+    int16_t box[4];         // EVENT_DETECT: 所有检测框的并集 x1,y1,x2,y2
+    uint16_t reserved;
+};
+
+#ifndef __cplusplus   // 文件格式，布局不能随编译器变化
+_Static_assert(sizeof(struct event_index_header) == 32, "event index header size");
+_Static_assert(sizeof(struct event_index_record) == 32, "event index record size");
+#endif
+
+// 检测汇总（写入方按周期累积）
+struct event_summary {
+    int count;
+    float max_score;
+    int x1, y1, x2, y2;
+};
+
+// 写入
+struct event_index_writer {
+    int fd;                 // -1表示未打开
+    char path[256];
+};
+
+int event_index_create(struct event_index_writer* w, const char* media_path,
+                       int64_t start_realtime_ms, uint32_t interval_ms);          // 创建与录像同名的索引文件
+int event_index_add_keyframe(struct event_index_writer* w, int64_t pts_ms, uint64_t offset);
+int event_index_add_detect(struct event_index_writer* w, int64_t pts_ms, int duration_ms,
+                           const struct event_summary* s);
+void event_index_close(struct event_index_writer* w);
+void event_summary_add(struct event_summary* s, int x1, int y1, int x2, int y2, float score); // 累积一个检测框
+void event_index_path(char* out, size_t size, const char* media_path);            // 录像文件名 -> 索引文件名
+
+// 读取（mmap）
+struct event_index {
+    void* map;
+    size_t map_size;
+    const struct event_index_header* header;
+    const struct event_index_record* records;
+    size_t count;           // 完整记录数（掉电时末尾可能有半条记录，忽略）
+};
+
+int event_index_map(struct event_index* idx, const char* path);
+void event_index_unmap(struct event_index* idx);
+size_t event_index_lower_bound(const struct event_index* idx, int64_t pts_ms);     // 第一条pts_ms >= 给定值的记录
+const struct event_index_record* event_index_keyframe_at(const struct event_index* idx, int64_t pts_ms); // pts_ms之前（含）最近的关键帧
+const struct event_index_record* event_index_keyframe_after(const struct event_index* idx, int64_t pts_ms); // pts_ms之后（含）第一个关键帧
+
+#endif // EVENT_INDEX_H
@@ -0,0 +1,82 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// 帧元数据：从DQBUF开始随帧在流水线中传递（显示、编码、检测）
+struct frame_meta {
+    uint32_t sequence;    // V4L2帧序号（驱动递增，出现跳变说明传感器帧被丢弃）
+    int64_t capture_ns;   // 采集时间戳（CLOCK_MONOTONIC，纳秒）
+};
+
+#define FRAME_FOURCC(a, b, c, d) \
+    ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+#define FRAME_FMT_NV12 FRAME_FOURCC('N', 'V', '1', '2')   // 与V4L2_PIX_FMT_NV12、DRM_FORMAT_NV12取值相同
+#define FRAME_MAX_PLANES 2
+
+/*
+* 帧描述：一帧图像在缓冲区中的实际布局
+* 各平面的偏移和行步长由缓冲区的提供方给出（V4L2的bytesperline、显示缓冲区的stride、帧池为紧凑排列），
+* 可以带硬件对齐；使用方按描述访问，不再假设UV平面紧跟在width*height之后
+*/
+struct frame_desc {
+    uint32_t fourcc;                     // 像素格式（目前只有FRAME_FMT_NV12）
+    int width, height;                   // 图像尺寸（像素）
+    int planes;                          // 平面数（NV12为2：Y、UV交织）
+    uint32_t offset[FRAME_MAX_PLANES];   // 各平面相对base的偏移（字节）
+    uint32_t stride[FRAME_MAX_PLANES];   // 各平面的行步长（字节）
+    uint8_t* base;                       // 缓冲区CPU地址
+    size_t size;                         // 缓冲区大小
+    int handle;                          // 缓冲区句柄（V4L2缓冲区序号等），-1表示没有
+    struct frame_meta meta;              // 序号与采集时间戳
+};
+
+// NV12帧描述（UV平面在uv_offset处，两个平面行步长相同）
+static inline struct frame_desc frame_desc_nv12(uint8_t* base, int width, int height,
+                                                uint32_t stride, uint32_t uv_offset) {
+    struct frame_desc f;
+    f.fourcc = FRAME_FMT_NV12;
+    f.width = width;
+    f.height = height;
+    f.planes = 2;
+    f.offset[0] = 0;
+    f.offset[1] = uv_offset;
+    f.stride[0] = f.stride[1] = stride;
+    f.base = base;
+    f.size = (size_t)uv_offset + (size_t)stride * (height / 2);
+    f.handle = -1;
+    f.meta.sequence = 0;
+    f.meta.capture_ns = 0;
+    return f;
+}
+
+// 紧凑排列的NV12（帧池、共享内存槽、文件源）
+static inline struct frame_desc frame_desc_nv12_packed(uint8_t* base, int width, int height) {
+    return frame_desc_nv12(base, width, height, (uint32_t)width, (uint32_t)width * height);
+}
+
+static inline uint8_t* frame_plane(const struct frame_desc* f, int plane) {
+    return f->base + f->offset[plane];
+}
+
+// 是否为紧凑排列（可以整帧一次拷贝）
+static inline bool frame_desc_is_packed(const struct frame_desc* f) {
+    return f->stride[0] == (uint32_t)f->width && f->stride[1] == (uint32_t)f->width &&
+           f->offset[0] == 0 && f->offset[1] == (uint32_t)f->width * f->height;
+}
+
+// 裁剪：只调整平面偏移和宽高，不拷贝数据（x、y、宽、高会向下取偶数，NV12的UV按2x2采样）
+static inline struct frame_desc frame_desc_crop(const struct frame_desc* f, int x, int y, int width, int height) {
+    struct frame_desc c = *f;
+    x &= ~1;
+    y &= ~1;
+    c.width = width & ~1;
+    c.height = height & ~1;
+    c.offset[0] += (uint32_t)y * f->stride[0] + x;
+    c.offset[1] += (uint32_t)(y / 2) * f->stride[1] + x;
+    return c;
+}
+
+#endif // FRAME_H
@@ -0,0 +1,46 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include "../include/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct frame_pool;
+
+// 帧池中的一帧（物理连续、带缓存的缓冲区，硬件读取前由CPU写回）
+struct pool_frame {
+    struct frame_pool* pool;   // 所属帧池
+    uint8_t* virt;             // 虚拟地址（CPU访问）
+    uint64_t phys;             // 物理地址（硬件访问，malloc后备时为0）
+    size_t size;               // 缓冲区大小
+    int refcount;              // 引用计数（__atomic内建函数操作）
+    int index;                 // 在帧池中的序号
+    struct frame_meta meta;    // 当前内容对应的帧序号与采集时间
+};
+
+// 固定数量的帧池：启动时一次性分配，运行中只借还，不再申请内存
+struct frame_pool {
+    const char* name;
+    size_t frame_size;
+    unsigned int count;
+    bool use_mmz;              // true: MMZ物理连续内存  false: malloc后备（主机上运行）
+    struct pool_frame* frames;
+    unsigned int* free_list;   // 空闲帧序号栈
+    unsigned int free_count;
+    uint64_t exhausted;        // 借帧失败次数（帧池耗尽）
+    pthread_mutex_t lock;
+};
+
+int frame_pool_init(struct frame_pool* pool, const char* name, size_t frame_size, unsigned int count);
+void frame_pool_destroy(struct frame_pool* pool);
+struct pool_frame* frame_pool_get(struct frame_pool* pool);  // 借一帧（引用计数为1），耗尽时返回NULL，不阻塞
+void pool_frame_put(struct pool_frame* f);                   // 释放引用，归零时归还帧池
+void pool_frame_flush(struct pool_frame* f);                 // CPU写完、交给硬件（ai2d）读取前：写回缓存
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FRAME_POOL_H
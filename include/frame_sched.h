@@ -0,0 +1,69 @@
+#ifndef FRAME_SCHED_H
+#define FRAME_SCHED_H
+
+#include "../include/common.h"
+
+// 帧的消费者（每个消费者有独立的目标帧率和优先级）
+enum sched_consumer {
+    SCHED_DISPLAY = 0,   // LCD显示
+    SCHED_RECORD,        // 编码保存
+    SCHED_DETECT,        // 行人检测（提交给检测线程）
+    SCHED_PUBLISH,       // 共享内存发布（供其他进程读取）
+    SCHED_SUBSTREAM,     // 子码流编码（远程观看）
+    SCHED_CONSUMER_NUM
+};
+
+// 丢帧原因
+enum sched_drop_reason {
+    SCHED_DROP_BUDGET = 0,   // 本帧预算不足，为高优先级消费者让路
+    SCHED_DROP_BUSY,         // 消费者忙（例如检测线程仍在处理上一帧）
+    SCHED_DROP_REASON_NUM
+};
+
+#define SCHED_DROP_LOG_SIZE 64   // 保留最近的丢帧记录条数
+
+// 一条丢帧记录
+struct sched_drop_record {
+    uint32_t sequence;       // 帧序号
+    uint8_t consumer;        // enum sched_consumer
+    uint8_t reason;          // enum sched_drop_reason
+    int64_t over_ns;         // 预计超出预算的时间
+};
+
+struct sched_consumer_state {
+    const char* name;
+    int fps;                 // 目标帧率，0表示跟随传感器
+    int priority;            // 优先级，数值越小越高；最高优先级的消费者不会因预算被丢弃
+    int64_t period_ns;       // 目标帧间隔
+    int64_t next_due_ns;     // 下一次运行的截止时间（CLOCK_MONOTONIC绝对时间，采集时间轴）
+    int64_t cost_ns;         // 执行耗时估计（指数平均）
+    bool due;                // 本帧是否到期
+    bool ran;                // 本帧是否已运行
+    uint64_t runs;           // 运行次数
+    uint64_t drops[SCHED_DROP_REASON_NUM];
+};
+
+// 基于绝对时间轴的帧调度器（只在主线程使用）
+struct frame_sched {
+    struct sched_consumer_state c[SCHED_CONSUMER_NUM];
+    int64_t sensor_period_ns;    // 传感器帧间隔估计（由采集时间戳得出）
+    int64_t last_capture_ns;     // 上一帧采集时间
+    int64_t frame_start_ns;      // 本帧开始处理的时间
+    uint32_t sequence;           // 本帧序号
+    int64_t loop_period_ns;      // 主循环节拍，0表示不限速（由DQBUF按传感器帧率驱动）
+    int64_t next_tick_ns;        // 下一个节拍（绝对时间）
+    struct sched_drop_record log[SCHED_DROP_LOG_SIZE];
+    unsigned int log_head;       // 下一条记录写入位置
+    uint64_t log_total;          // 累计记录条数
+};
+
+void frame_sched_init(struct frame_sched* fs, int loop_fps);
+void frame_sched_set_rate(struct frame_sched* fs, enum sched_consumer c, const char* name, int fps, int priority);
+void frame_sched_begin(struct frame_sched* fs, const struct frame_meta* meta);   // 每帧出队后调用
+bool frame_sched_should_run(struct frame_sched* fs, enum sched_consumer c);      // 是否运行该消费者（超预算时记录丢帧）
+void frame_sched_done(struct frame_sched* fs, enum sched_consumer c, int64_t cost_ns); // 运行结束，更新耗时估计
+void frame_sched_drop(struct frame_sched* fs, enum sched_consumer c, enum sched_drop_reason reason); // 记录其他原因的丢帧
+void frame_sched_wait(struct frame_sched* fs);                                    // 限速时按绝对时间休眠到下一个节拍
+void frame_sched_report(struct frame_sched* fs);
+
+#endif // FRAME_SCHED_H
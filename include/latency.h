@@ -0,0 +1,56 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "../include/common.h"
+
+// 延迟统计的测量点（从采集时间戳算起）
+enum latency_stage {
+    LAT_DISPLAY = 0,   // 显示提交完成
+    LAT_ENCODE,        // 编码完成
+    LAT_DETECT,        // 检测完成
+    LAT_STAGE_NUM
+};
+
+#define LAT_HIST_BUCKETS 256   // 直方图：1ms一个桶，最后一个桶收集>=255ms
+
+struct latency_hist {
+    uint64_t count;
+    int64_t sum_ns;
+    int64_t min_ns;
+    int64_t max_ns;
+    uint32_t bucket[LAT_HIST_BUCKETS];
+};
+
+// 延迟与丢帧统计（主线程与检测线程共用，内部加锁）
+struct latency_stats {
+    pthread_mutex_t lock;
+    struct latency_hist stage[LAT_STAGE_NUM];
+    bool have_seq;          // 是否已有上一帧序号
+    uint32_t last_seq;      // 上一帧序号
+    uint64_t frames;        // 收到的帧数
+    uint64_t dropped;       // 根据序号跳变推算的传感器丢帧数
+};
+
+void latency_init(struct latency_stats* ls);
+void latency_destroy(struct latency_stats* ls);
+void latency_record(struct latency_stats* ls, enum latency_stage stage, const struct frame_meta* meta); // 记录 当前时间-采集时间
+uint32_t latency_track_sequence(struct latency_stats* ls, const struct frame_meta* meta);              // 返回本帧之前丢失的帧数
+void latency_reset_sequence(struct latency_stats* ls);                                                  // 重新开流后序号从头开始
+void latency_report(struct latency_stats* ls);                                                          // 打印并清空本统计窗口
+
+// 采集缓冲区数量自动调节：从最小值开始逐个尝试，取第一个在实际负载下不丢帧的数量
+struct buf_autotune {
+    bool enabled;
+    bool done;
+    unsigned int count;        // 当前尝试的缓冲区数量
+    unsigned int max_count;    // 尝试上限
+    unsigned int warmup;       // 每次重新开流后忽略的帧数
+    unsigned int window;       // 每次尝试统计的帧数
+    unsigned int seen;         // 本次尝试已经过的帧数
+    uint64_t start_dropped;    // 本次尝试开始时的丢帧计数
+};
+
+void autotune_init(struct buf_autotune* at, unsigned int min_count, unsigned int max_count);
+unsigned int autotune_update(struct buf_autotune* at, const struct latency_stats* ls); // 返回需要切换到的缓冲区数量，0表示保持
+
+#endif // LATENCY_H
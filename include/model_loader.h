@@ -0,0 +1,37 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include "../include/common.h"
+
+// 模型加载状态
+enum model_state {
+    MODEL_LOADING = 0,  // 后台加载/预热中
+    MODEL_READY,        // 可用于检测
+    MODEL_FAILED        // 加载失败（视频流继续运行，只是没有检测）
+};
+
+// 后台模型加载器：预取kmodel文件 -> 加载模型 -> 空帧预热推理
+struct model_loader {
+    // 配置参数
+    const char* model_path;  // kmodel路径
+    float conf_threshold;    // 检测框阈值
+    float nms_threshold;     // NMS阈值
+    int warmup_width;        // 预热帧宽（与实际检测帧一致）
+    int warmup_height;       // 预热帧高
+
+    // 运行状态
+    pthread_t thread;
+    atomic_int state;        // enum model_state
+    bool started;
+
+    // 各阶段耗时（纳秒），加载线程结束后有效
+    int64_t prefetch_ns;     // mmap预取kmodel到页缓存
+    int64_t load_ns;         // 构造personDetect（解析模型）
+    int64_t warmup_ns;       // 首次推理预热
+};
+
+int model_loader_start(struct model_loader* ml);          // 启动后台加载线程
+bool model_loader_ready(struct model_loader* ml);         // 模型是否可用（无锁查询）
+int model_loader_join(struct model_loader* ml);           // 等待加载线程结束，返回0表示模型可用
+
+#endif // MODEL_LOADER_H
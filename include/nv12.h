@@ -0,0 +1,30 @@
+#ifndef NV12_H
+#define NV12_H
+
+#include "../include/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// NV12图像统一用struct frame_desc描述（frame.h），各平面可以有各自的偏移和行步长
+
+// NV12 -> 平面BGR（CHW，3*width*height字节），BT.601视频范围，与OpenCV的COLOR_YUV2BGR_NV12结果一致
+void nv12_to_bgr_chw(const struct frame_desc* img, uint8_t* chw);
+
+#define NV12_SCALE_MAX_WIDTH 4096   // 缩放输出的最大宽度
+
+// NV12缩放到dst的尺寸（偶数宽高，缩小、放大都可以；src可以是frame_desc_crop得到的裁剪区域）：
+// 正好缩小一半时按2x2取平均，8字节一组并行处理；其他比例用查表的两步双线性插值
+// @return: 0 成功, -1 尺寸不支持
+int nv12_scale(const struct frame_desc* src, const struct frame_desc* dst);
+
+// 按两边的布局拷贝一帧（尺寸相同）：平面行内没有填充时整块拷贝，否则逐行拷贝，只写宽度以内的字节（dst可以是裁剪区域）
+// @return: 0 成功, -1 尺寸或格式不一致
+int nv12_copy(const struct frame_desc* dst, const struct frame_desc* src);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NV12_H
@@ -3,24 +3,16 @@
 
 #include <iostream>
 #include <vector>
+#include <map>
+#include <tuple>
 #include "utils.h"
 #include "ai_base.h"
+#include "yolo_decoder.h"
 
+struct zone_map;
 
-// 源码来源：k230_sdk 例程
-/**
- * @brief 行人检测框信息
- */
-typedef struct BoxInfo
-{
-    float x1;   // 行人检测框左上顶点x坐标
-    float y1;   // 行人检测框左上顶点y坐标
-    float x2;   // 行人检测框右下顶点x坐标
-    float y2;   // 行人检测框右下顶点y坐标
-    float score;    // 行人检测框的得分
-    int label;  // 行人检测框的标签
-} BoxInfo;
 
+// 源码来源：k230_sdk 例程
 /**
  * @brief 基于 personDetect 的行人检测任务
  * 主要封装了对于每一帧图片，从预处理、运行到后处理给出结果的过程
@@ -58,13 +50,6 @@ class personDetect: public AIBase
         ~personDetect();
 
 
-        /**
-         * @brief 图片预处理（ai2d for image）
-         * @param ori_img 原始图片
-         * @return None
-         */
-        void pre_process(cv::Mat ori_img);
-
         /**
         * @brief 视频流预处理（ai2d for isp）
         * @param img_data 当前视频帧数据
@@ -72,12 +57,52 @@ class personDetect: public AIBase
         */
         void pre_process(runtime_tensor& img_data);
 
+        /**
+        * @brief CHW数据预处理（ai2d padding resize），CPU部分的颜色转换与重排已在外部完成（视频帧见nv12_to_bgr_chw，图片由调用方重排）
+        * @param chw_shape chw_vec的形状
+        * @param chw_vec   CHW格式的BGR数据
+        * @return None
+        */
+        void pre_process(FrameCHWSize chw_shape, std::vector<uint8_t>& chw_vec);
+
+        /**
+        * @brief 同上，数据为chw_shape大小的连续内存（拷进复用的输入tensor后invoke）
+        * @param chw_shape 输入形状
+        * @param chw       CHW格式的BGR数据
+        * @return None
+        */
+        void pre_process(FrameCHWSize chw_shape, const uint8_t *chw);
+
+        /**
+        * @brief CHW数据预处理，ai2d直接读取调用方的物理连续缓冲区（不拷贝；调用方在此之前写回CPU缓存）
+        * @param chw_shape 输入形状
+        * @param in_tensor wrap_input创建的输入tensor
+        * @return None
+        */
+        void pre_process(FrameCHWSize chw_shape, runtime_tensor& in_tensor);
+
+        /**
+        * @brief 在已有的物理连续缓冲区（如MMZ帧池）上创建ai2d输入tensor，不分配、不拷贝
+        * @param chw_shape 输入形状
+        * @param virt      缓冲区虚拟地址
+        * @param phys      缓冲区物理地址
+        * @return 输入tensor（只引用缓冲区，缓冲区须比tensor活得久）
+        */
+        static runtime_tensor wrap_input(FrameCHWSize chw_shape, uint8_t *virt, uint64_t phys);
+
         /**
          * @brief kmodel推理
          * @return None
          */
         void inference();
 
+        /**
+         * @brief 拷出本次推理的输出（下一次推理会覆盖输出tensor，流水线后处理需要自己的副本）
+         * @param outputs 每个输出一个数组
+         * @return None
+         */
+        void copy_outputs(std::vector<std::vector<uint8_t>>& outputs);
+
         /** 
         * @brief postprocess 函数，对输出解码后的结果，进行NMS处理
         * @param frame_size 帧大小
@@ -86,21 +111,77 @@ class personDetect: public AIBase
         */
         void post_process(FrameSize frame_size,std::vector<BoxInfo> &result);
 
+        /** 
+        * @brief postprocess 函数，对给定的输出（copy_outputs的结果）解码并NMS，可与下一帧推理并行
+        * @param frame_size 帧大小
+        * @param result   所有候选检测框
+        * @param outputs  各输出的数据（按head_quant_中的类型解释）
+        * @return None
+        */
+        void post_process(FrameSize frame_size,std::vector<BoxInfo> &result, const std::vector<const void*>& outputs);
+
+        /**
+         * @brief 设置检测区域，后处理在NMS之前按区域过滤（区域数据由调用方持有，推理期间不能修改）
+         * @param zones 区域位图，为NULL时不过滤
+         * @return None
+         */
+        void set_zones(const zone_map *zones);
+
+        /**
+         * @brief ai2d缓存命中统计（CHW预处理按输入形状复用builder）
+         * @param hits   命中次数
+         * @param misses 未命中次数（即新建builder的次数）
+         * @return None
+         */
+        void ai2d_cache_stats(uint64_t &hits, uint64_t &misses) const;
+
         std::vector<std::string> labels { "person" }; // 类别标签
 
     private:
         float obj_thresh_;  // 检测框阈值
         float nms_thresh_;  // NMS阈值
         
-        int anchors_num_ = 3;  // 锚框个数
-        int classes_num_ = 1;   // 类别数
-        int channels_ = anchors_num_ * (5 + classes_num_);  // 通道数
+        int classes_num_ = 1;   // 类别数（加载时由输出形状得出）
+        HeadFormat head_format_ = HeadFormat::AnchorV5;  // 输出头格式（加载时由输出形状得出）
+        std::vector<const DecoderEntry *> decoders_;     // 各输出头的解码器
         float anchors_0_[3][2] = { { 10, 13 }, { 16, 30 }, { 33, 23 } };  // 第一组锚框
         float anchors_1_[3][2] = { { 30, 61 }, { 62, 45 }, { 59, 119 } };  // 第二组锚框
         float anchors_2_[3][2] = { { 116, 90 }, { 156, 198 }, { 373, 326 } }; // 第三组锚框
 
-        std::unique_ptr<ai2d_builder> ai2d_builder_; // ai2d构建器
-        runtime_tensor ai2d_in_tensor_;              // ai2d输入tensor
+        std::vector<HeadQuant> head_quant_;          // 各输出头的类型与量化参数
+        const zone_map *zones_ = nullptr;            // 检测区域（NULL表示不过滤）
+
+        /**
+         * @brief 由输出形状确定输出头格式和类别数，读取输出类型（8位输出时从 <kmodel>.quant 读取量化参数，
+         *        每行一个头：scale zero_point），并为每个输出头选择编译期特化的解码器
+         * @param kmodel_file kmodel文件路径
+         * @return None（格式不支持或缺少量化参数时抛出异常）
+         */
+        void init_decoder(const char *kmodel_file);
+        void load_head_quant(const char *kmodel_file);
+
+        // ai2d缓存项：同一输入形状/格式的builder和输入tensor只建一次，之后每帧直接invoke
+        struct Ai2dCacheEntry
+        {
+            std::unique_ptr<ai2d_builder> builder; // ai2d构建器（已build_schedule）
+            runtime_tensor in_tensor;              // 复用的输入tensor（拷贝路径第一次使用时创建）
+            uint64_t last_used = 0;                // 最近一次使用的序号（淘汰最久未用的一项）
+        };
+        using Ai2dKey = std::tuple<size_t, size_t, size_t, int>; // channel, height, width, ai2d_format
+
+        /**
+         * @brief 取输入形状对应的ai2d缓存项，没有则新建（按图像居中填充，填充按make_letterbox，与解码时的坐标换算一致）
+         * @param shape  输入形状（chw）
+         * @param format 输入格式
+         * @return 缓存项
+         */
+        Ai2dCacheEntry &ai2d_lookup(FrameCHWSize shape, ai2d_format format);
+
+        std::map<Ai2dKey, Ai2dCacheEntry> ai2d_cache_; // ai2d缓存
+        uint64_t ai2d_cache_hits_ = 0;                 // 缓存命中次数
+        uint64_t ai2d_cache_misses_ = 0;               // 缓存未命中次数
+        uint64_t ai2d_cache_tick_ = 0;                 // 使用序号
+
         runtime_tensor ai2d_out_tensor_;             // ai2d输出tensor
         FrameCHWSize isp_shape_;                     // isp对应的地址大小
 
@@ -1,6 +1,8 @@
 #ifndef PERSON_DETECT_CAPI_H
 #define PERSON_DETECT_CAPI_H
 #include <stdint.h>
+#include <stdbool.h>
+#include "frame.h"   // struct frame_desc
 
 #ifdef __cplusplus
 extern "C" {
@@ -19,10 +21,37 @@ struct all_det_location{
     int count; // 检测到的行人数量
 };
 
+struct zone_map;
+
 bool init_person_detector(const char* model_path, float conf_threshold, float nms_threshold, int num_class);
 void destroy_person_detector();
-void detectjpg();
-struct all_det_location* detectframe(uint8_t* nv12_data, int width, int height);
+struct all_det_location* detectframe(const struct frame_desc* frame);  // 同步检测一帧NV12（按帧描述的布局读取）
+bool warmup_person_detector(int width, int height);      // 空帧预热推理（首帧推理耗时不计入实际检测）
+void free_det_location(struct all_det_location* all_loc); // 释放detectframe返回的结果
+bool set_person_detector_zones(const struct zone_map* zones); // 设置检测区域（在det_async_start之前调用，NULL表示不过滤）
+
+// 异步检测：预处理(CPU) -> 推理(KPU) -> 后处理(CPU) 三级流水线，
+// 多帧在途时各级并行，吞吐取决于最慢的一级而不是三级之和
+enum det_stage { DET_STAGE_PRE = 0, DET_STAGE_KPU, DET_STAGE_POST, DET_STAGE_NUM };
+
+struct det_result {
+    uint64_t id;                         // 提交时的帧号
+    int64_t timestamp_ns;                // 提交时的时间戳
+    void* user;                          // 提交时的用户数据（帧数据在结果返回前必须保持有效）
+    struct all_det_location* locations;  // 检测结果，无人时为NULL；由接收方用free_det_location释放
+    int64_t stage_ns[DET_STAGE_NUM];     // 各级耗时
+};
+
+typedef void (*det_result_cb)(struct det_result* result, void* arg);
+
+// 启动流水线（模型初始化之后；启动后不要再调用detectframe）
+// @depth: 最多在途帧数；@cb: 结果回调（在后处理线程中调用），为NULL时用det_async_poll取结果
+bool det_async_start(int width, int height, int depth, det_result_cb cb, void* arg);
+bool det_async_ready(void);   // 是否还能提交（在途帧数未满）
+// 提交一帧（尺寸与det_async_start一致，缓冲区在结果返回前必须保持有效）：0 成功, 1 在途已满, -1 未启动或尺寸不符
+int det_async_submit(const struct frame_desc* frame, uint64_t id, int64_t timestamp_ns, void* user);
+bool det_async_poll(struct det_result* result, int timeout_ms); // 取一个结果（回调模式下不使用），超时返回false
+void det_async_stop(void);    // 处理完已提交的帧后停止（回调模式下所有结果都会回调）
 
 
 #ifdef __cplusplus
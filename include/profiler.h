@@ -0,0 +1,48 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "../include/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+* 进程内采样分析（perf_event_open，板子上不需要perf工具）
+* - 采样：在主线程按CPU打开按频率采样的事件并继承到之后创建的所有线程（包括编码库内部线程），
+*   后台线程读取内核环形缓冲区，按线程统计指令地址
+* - 阶段计数：每个线程一组计数器（任务时钟、周期、指令、缓存缺失），在阶段开始/结束时读取，按阶段累计
+* - 结束时用构建时生成的符号表（未strip副本的nm输出）把地址换成函数名，写出报告
+* 只统计用户态（perf_event_paranoid默认值下也能打开）；硬件计数器不可用时采样退回到CPU时钟，计数显示为-
+*/
+
+#define PROF_SAMPLE_HZ     997    // 采样频率（取质数，避免和帧率同步）
+#define PROF_RING_PAGES    64     // 采样环形缓冲区页数（2的幂）
+#define PROF_MAX_CPUS      8      // 采样事件按CPU打开
+#define PROF_POLL_MS       50     // 后台读取周期
+#define PROF_MAX_THREADS   32     // 参与阶段计数的线程上限
+#define PROF_MAX_STAGES    16     // 每个线程的阶段数上限
+#define PROF_STAGE_DEPTH   4      // 阶段嵌套深度上限
+#define PROF_TOP_SYMBOLS   40     // 报告中每个线程列出的热点函数数
+
+extern int prof_on;   // 分析已启动（prof_begin/prof_end据此决定是否读计数器）
+
+// 在创建任何线程之前调用：sym_path为NULL时使用可执行文件路径加".sym"，0 成功, -1 失败
+int profiler_start(const char* out_path, const char* sym_path);
+void profiler_stop(void);                   // 停止采样，符号化后写出报告
+void prof_stage_push(const char* stage);    // 阶段开始（stage须为常量字符串）
+void prof_stage_pop(void);                  // 阶段结束，计数差值累计到该阶段
+
+static inline void prof_begin(const char* stage) {
+    if (prof_on) prof_stage_push(stage);
+}
+
+static inline void prof_end(void) {
+    if (prof_on) prof_stage_pop();
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILER_H
@@ -2,15 +2,41 @@
 #define SAVE_VIDEO_H
 
 #include "../include/common.h"   
+#include "../include/person_detect_capi.h"  // 检测结果（用于码率控制与ROI）
+#include "../include/segment_writer.h"      // 分段录像文件
+#include "../include/event_index.h"         // 录像事件索引
+
+#define ENC_MAX_ROI 16   // ROI区域上限
+#define ENC_TIME_BASE 90000   // 编码时间基（1/90000秒）：时间戳取自采集时间，帧间隔不固定
 
 typedef struct {
     // 配置参数
+    const char* name;           // 统计打印用的名称（如“主码流”“子码流”）
     int width;
     int height;
-    int frame_rate;
+    int frame_rate;             // 标称帧率（码率控制和关键帧间隔用，实际时间戳按采集时间）
     int bit_rate;
     int max_rate;
-    const char* output_file;
+    int gop;                    // 关键帧间隔（帧，0为编码器默认；启用检测码率控制时不使用）
+    const char* output_file;    // 单文件录像（output_dir为NULL时使用；两者都为NULL时只编码，输出交给on_packet）
+
+    // 分段录像（output_dir不为NULL时启用：fMP4分段，每段独立可播放）
+    const char* output_dir;     // 分段目录
+    int segment_seconds;        // 每段时长（秒）
+    uint64_t segment_prealloc;  // 每段预分配字节数
+    uint64_t disk_budget;       // 分段目录总大小上限（字节，0表示不限制）
+    int index_interval_ms;      // 事件索引的检测汇总周期（每个分段生成同名.idx，0表示不生成）
+
+    // 检测驱动的码率控制（quiet_bit_rate为0时不调节，始终用bit_rate）
+    int quiet_bit_rate;     // 画面中无人时的目标码率
+    int quiet_frame_div;    // 无人时每N帧编码1帧（<=1表示不降帧）
+    int active_gop;         // 有人时的关键帧间隔（帧），无人时使用更长的gop
+    int active_hold_ms;     // 最后一次检测到人之后保持“有人”状态的时间
+    float roi_qoffset;      // ROI量化偏移（-1~0，越小行人区域质量越高），0表示不使用ROI
+
+    // 编码包回调（如实时流），在写文件之前调用，回调内需要保留的包用av_packet_ref引用
+    void (*on_packet)(void* opaque, const AVPacket* pkt);
+    void* on_packet_opaque;
     
     // FFmpeg相关对象
     AVFormatContext* fmt_ctx;
@@ -20,14 +46,39 @@ typedef struct {
     struct SwsContext* sws_ctx;
     
     // 状态变量
-    int64_t frame_count;
+    int64_t frame_count;      // 输入帧计数（无人降帧按输入帧抽取）
+    int64_t first_capture_ns; // 第一帧的采集时间（时间戳原点）
+    int64_t last_capture_ns;  // 上一输入帧的采集时间
+    int64_t last_pts;         // 上一编码帧的时间戳（保证严格递增）
     int initialized;
+    int header_written;       // 当前输出已写文件头
+    struct segment_writer seg;
+    int64_t seg_first_pts;    // 当前分段第一帧的时间戳（分段内时间戳从0开始）
+    int segment_due;          // 分段时长已到，等待关键帧切换
+    struct event_index_writer index;
+    int64_t summary_start_ms; // 当前检测汇总区间的起点（分段内时间）
+    int64_t last_mux_pts;     // 最后写入当前分段的包的时间戳（编码器时间基）
+
+    // 检测结果（检测线程写入，编码线程读取）
+    pthread_mutex_t det_lock;
+    struct det_location roi[ENC_MAX_ROI];
+    int roi_count;
+    int64_t last_active_ns;   // 最后一次检测到人的时间
+    struct event_summary det_summary; // 当前汇总区间内的检测结果（写入事件索引）
+    int active;               // 当前是否处于“有人”档位
+    int64_t active_frames;    // 当前档位下已编码帧数（用于关键帧间隔）
+    uint64_t bytes[2];        // 各档位写出的字节数 [0]无人 [1]有人
+    uint64_t frames[2];       // 各档位编码的帧数
+    int64_t span_ns[2];       // 各档位经过的采集时间（统计平均码率）
+    int64_t encode_ns;        // 编码累计耗时（送帧到取完包，不含写文件）
+    int64_t encode_max_ns;    // 单帧最大编码耗时
 } VideoEncoder;
 
 
 int video_encoder_init(VideoEncoder* enc);
-int video_encoder_process(VideoEncoder* enc, uint8_t* cam_data) ;
+int video_encoder_process(VideoEncoder* enc, const struct frame_desc* frame); // frame->meta.capture_ns: 采集时间戳（0表示用当前时间）
 void video_encoder_release(VideoEncoder* enc);
+void video_encoder_update_detections(VideoEncoder* enc, const struct all_det_location* all_loc); // 更新最新检测结果（任意线程）
 
 
 #endif // SAVE_VIDEO_H
\ No newline at end of file
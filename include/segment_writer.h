@@ -0,0 +1,29 @@
+#ifndef SEGMENT_WRITER_H
+#define SEGMENT_WRITER_H
+
+#include <stdint.h>
+
+// 分段录像文件：预分配空间、平滑回写、按磁盘预算删除最旧的分段
+struct segment_writer {
+    // 配置参数
+    const char* dir;            // 输出目录
+    const char* prefix;         // 文件名前缀，文件名为 <prefix>_YYYYmmdd_HHMMSS[_NN].mp4
+    uint64_t prealloc_bytes;    // 每个分段预分配的空间
+    uint64_t disk_budget;       // 目录内分段总大小上限（0表示不限制）
+
+    // 当前分段
+    int fd;
+    char path[256];
+    int64_t pos;                // 当前写入位置
+    int64_t size;               // 文件实际大小
+    int64_t synced;             // 已提交回写的位置
+};
+
+int segment_writer_open(struct segment_writer* sw);                              // 新建一个分段文件
+int segment_writer_write(struct segment_writer* sw, const uint8_t* buf, int len); // 写入当前位置（AVIO写回调）
+int64_t segment_writer_seek(struct segment_writer* sw, int64_t offset, int whence); // AVIO定位回调
+void segment_writer_sync(struct segment_writer* sw);                             // 提交已写数据的异步回写（分片边界调用）
+void segment_writer_close(struct segment_writer* sw);                            // 截掉预分配余量并关闭，然后执行磁盘预算
+void segment_writer_enforce_quota(struct segment_writer* sw);                    // 删除最旧的分段直到满足预算
+
+#endif // SEGMENT_WRITER_H
@@ -0,0 +1,97 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "person_detect_capi.h"   // struct det_location
+#include "frame.h"                // struct frame_desc
+
+/*
+* 共享内存帧/检测结果发布（POSIX共享内存，/dev/shm/<name>）
+*
+* 布局：头部 | 帧环（frame_slots个NV12槽） | 检测环（det_slots个结果槽）
+* 两个环各只有一个写者（帧：采集线程，检测：检测线程），每个槽带一个序号锁：
+*   写者：lock = 2n-1（写入中） -> 写数据 -> lock = 2n（第n个已发布）
+*   读者：读lock -> 使用数据 -> 再读lock，两次相同且为2n才有效
+* 读者不加锁、不通知写者，跟不上时直接跳到最新的一帧，不会阻塞写者
+* 不依赖FFmpeg/显示，其他进程只需链接shm_ring.c（参考tools/shmview.c）
+*/
+#define SHM_RING_MAGIC   "K230SHMR"
+#define SHM_RING_VERSION 1
+#define SHM_DET_MAX      32     // 每个检测槽最多保存的框数
+#define SHM_SLOT_ALIGN   4096   // 帧槽按页对齐
+
+struct shm_ring_header {
+    char magic[8];              // 初始化完成后最后写入
+    uint32_t version;
+    uint32_t producer_pid;
+    uint32_t width, height;
+    uint32_t frame_size;        // NV12帧字节数
+    uint32_t frame_slots;
+    uint64_t frame_offset;      // 第一个帧槽相对共享内存起点的偏移
+    uint64_t frame_stride;      // 帧槽间距
+    uint32_t det_slots;
+    uint32_t det_max;
+    uint64_t det_offset;
+    uint64_t frame_head;        // 最新已发布帧的编号（从1开始，0表示尚无）
+    uint64_t det_head;          // 最新已发布检测结果的编号
+};
+
+struct shm_frame_slot {
+    uint64_t lock;              // 序号锁
+    uint32_t sequence;          // 采集序号（v4l2），与检测结果对应
+    uint32_t reserved;
+    int64_t capture_ns;         // 采集时间（CLOCK_MONOTONIC）
+    // 槽首页之后是NV12数据（frame_offset + i * frame_stride + SHM_SLOT_ALIGN）
+};
+
+struct shm_det_slot {
+    uint64_t lock;
+    uint32_t sequence;          // 对应帧的采集序号
+    uint32_t count;
+    int64_t capture_ns;
+    struct det_location boxes[SHM_DET_MAX];
+};
+
+// 写入方（流水线进程）
+struct shm_ring {
+    char name[64];
+    void* map;
+    size_t map_size;
+    struct shm_ring_header* header;
+    uint64_t published;         // 已发布帧数
+};
+
+int shm_ring_create(struct shm_ring* ring, const char* name, int width, int height,
+                    int frame_slots, int det_slots);                     // 创建并映射共享内存
+void shm_ring_publish_frame(struct shm_ring* ring, const struct frame_desc* frame);
+void shm_ring_publish_detections(struct shm_ring* ring, const struct all_det_location* all_loc,
+                                 uint32_t sequence, int64_t capture_ns); // all_loc可为NULL（无人）
+void shm_ring_destroy(struct shm_ring* ring);                           // 解除映射并删除共享内存
+
+// 读取方（其他进程，只读映射）
+struct shm_frame_view {
+    uint64_t id;                // 帧编号
+    uint32_t sequence;
+    int64_t capture_ns;
+    const uint8_t* nv12;        // 直接指向共享内存，使用完后用shm_reader_frame_valid确认未被覆盖
+};
+
+struct shm_reader {
+    void* map;
+    size_t map_size;
+    const struct shm_ring_header* header;
+    uint64_t last_frame;        // 上一次读到的帧编号
+    uint64_t last_det;
+    uint64_t skipped;           // 跟不上而跳过的帧数
+    uint64_t torn;              // 使用期间被覆盖的帧数
+};
+
+int shm_reader_open(struct shm_reader* rd, const char* name);
+void shm_reader_close(struct shm_reader* rd);
+bool shm_reader_next_frame(struct shm_reader* rd, struct shm_frame_view* view); // 取下一帧（落后太多时跳到最新），没有新帧返回false
+bool shm_reader_frame_valid(struct shm_reader* rd, const struct shm_frame_view* view); // 帧数据是否仍然有效
+bool shm_reader_latest_detections(struct shm_reader* rd, struct shm_det_slot* out); // 复制最新一次检测结果，没有新结果返回false
+
+#endif // SHM_RING_H
@@ -25,13 +25,13 @@ int drm_nv12_init(struct mydisplay* mydis);  // 初始化显示
 void mydisplay_destroy(struct mydisplay* mydis); // 销毁显示资源
 void draw_box(struct mydisplay *mydis, struct all_det_location* all_loc); // 绘制检测到的行人方框
 void draw_one_box(struct mydisplay *mydis, int x1, int y1, int x2, int y2);  // 绘制方框
+void draw_boxes(struct mydisplay *mydis, const struct det_location* boxes, int count); // 重画叠加层（不释放boxes，count为0时清空）
 void clear_box(struct mydisplay *mydis); // 清除方框显示
+void mydisplay_frame(struct mydisplay *mydis, int index, struct frame_desc *frame); // 显示缓冲区index的帧描述（按缓冲区的stride）
 
 // 处理 NV12 帧，旋转并缩放到指定屏幕尺寸
 void process_frame_nv12(  // // 处理 NV12 帧，旋转并缩放到指定屏幕尺寸
-    uint8_t* nv12_frame,  // 输入 NV12 帧地址 (Y 平面 + UV 交织平面)
-    int width,            // 帧宽 (需为偶数)
-    int height,           // 帧高 (需为偶数)
+    const struct frame_desc* src, // 输入 NV12 帧 (Y 平面 + UV 交织平面，宽高需为偶数)
     uint8_t* out_buffer,  // 输出缓冲区 (转换后的 NV12 帧)
     int screen_width,     // 屏幕宽 (需为偶数)
     int screen_height,    // 屏幕高 (需为偶数)
@@ -0,0 +1,44 @@
+#ifndef STREAM_SERVER_H
+#define STREAM_SERVER_H
+
+#include "../include/common.h"
+
+#define STREAM_MAX_CLIENTS  8    // 同时观看的客户端上限
+#define STREAM_CLIENT_QUEUE 64   // 每个客户端最多排队的包数，超出时丢包直到下一个关键帧
+#define STREAM_PREFIX_MAX   1024 // HTTP响应头 + SPS/PPS
+
+// 一个观看客户端
+struct stream_client {
+    int fd;                               // -1表示空闲
+    char req[512];                        // HTTP请求（只读到空行为止）
+    size_t req_len;
+    bool streaming;                       // 请求已收完，开始推流
+    bool waiting_key;                     // 从下一个关键帧开始发送（新连接或丢包之后）
+    uint8_t prefix[STREAM_PREFIX_MAX];    // 推流前先发送的数据
+    size_t prefix_len, prefix_off;
+    AVPacket* queue[STREAM_CLIENT_QUEUE]; // 排队的包（引用计数共享编码器输出，不复制数据）
+    unsigned int head, count;
+    size_t offset;                        // 队首包已发送的字节数
+    uint64_t sent, dropped;
+};
+
+// 本地实时流服务：HTTP输出H.264裸流（Annex-B），
+// 多个客户端共享同一份编码输出，增加观看者不增加编码工作量
+struct stream_server {
+    int port;
+    int listen_fd;
+    int wake_fd;                          // eventfd：有新包时唤醒发送线程
+    pthread_t thread;
+    bool running;
+    pthread_mutex_t lock;
+    struct stream_client clients[STREAM_MAX_CLIENTS];
+    uint8_t extradata[STREAM_PREFIX_MAX / 2]; // SPS/PPS（Annex-B）
+    int extradata_size;
+};
+
+int stream_server_start(struct stream_server* srv, int port);                     // 监听端口并启动发送线程
+void stream_server_set_extradata(struct stream_server* srv, const uint8_t* data, int size); // 设置SPS/PPS，新客户端连接时先发送
+void stream_server_publish(struct stream_server* srv, const AVPacket* pkt);       // 发布一个编码包（编码线程调用）
+void stream_server_stop(struct stream_server* srv);
+
+#endif // STREAM_SERVER_H
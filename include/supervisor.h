@@ -0,0 +1,52 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include "../include/common.h"
+
+// 可单独重建的子系统（模型、帧池不在其中：重建时保持加载状态）
+enum sv_subsys {
+    SV_CAMERA = 0,   // 采集：DQBUF超时/出队入队失败
+    SV_DISPLAY,      // 显示：连续提交失败（如drmModeAtomicCommit -12）
+    SV_ENCODER,      // 编码器：编码/写文件失败
+    SV_SUBSYS_NUM
+};
+
+struct sv_stat {
+    uint64_t restarts;        // 成功重建次数
+    uint64_t failures;        // 重建失败次数
+    int64_t total_ns;         // 重建总耗时（恢复时间）
+    int64_t max_ns;           // 最长一次恢复时间
+    int64_t window_start_ns;  // 当前限流窗口起点
+    int window_count;         // 当前窗口内的重建次数
+};
+
+// 故障监控与子系统热重建
+struct supervisor {
+    // 配置参数
+    int stall_timeout_ms;     // 多久没有新帧算采集卡死
+    int commit_fail_limit;    // 连续多少次显示提交失败后重建显示
+    int max_restarts;         // 每个子系统在restart_window_ms内最多重建次数，超出后放弃（程序退出）
+    int restart_window_ms;
+
+    // 运行状态
+    pthread_mutex_t lock;     // 重建显示/编码器时持有；检测回调访问显示和编码器前也要持有
+    int commit_fails;         // 连续显示提交失败次数
+    struct sv_stat stat[SV_SUBSYS_NUM];
+};
+
+void supervisor_init(struct supervisor* sv);
+void supervisor_destroy(struct supervisor* sv);
+bool supervisor_commit_failed(struct supervisor* sv); // 记录一次提交失败，返回true表示需要重建显示
+void supervisor_commit_ok(struct supervisor* sv);
+
+// 重建子系统，返回0成功，-1失败或超出重建次数限制（调用方应退出）
+int supervisor_restart_camera(struct supervisor* sv, struct v4l2_capture* cam, const char* dev,
+                              uint32_t width, uint32_t height, unsigned int buffer_count);
+int supervisor_restart_display(struct supervisor* sv, struct mydisplay* disp);
+int supervisor_restart_encoder(struct supervisor* sv, VideoEncoder* enc);
+// 计划内重配置采集（不计入重建次数和恢复统计），返回0成功，-1失败
+int supervisor_reconfigure_camera(struct supervisor* sv, struct v4l2_capture* cam, const char* dev,
+                                  uint32_t width, uint32_t height, unsigned int buffer_count);
+void supervisor_report(struct supervisor* sv);
+
+#endif // SUPERVISOR_H
@@ -0,0 +1,40 @@
+#ifndef THREAD_POLICY_H
+#define THREAD_POLICY_H
+
+#include "../include/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 流水线线程角色
+enum thread_role {
+    ROLE_CAPTURE = 0,   // 主线程：采集、显示（实时性要求最高）
+    ROLE_WRITER,        // 存储写入、网络发送
+    ROLE_DETECT,        // 行人检测
+    ROLE_LOADER,        // 启动期的初始化/模型加载
+    ROLE_NUM
+};
+
+// 每种角色的调度策略
+struct thread_policy {
+    const char* name;     // 线程名（最长15字符，top -H / ps -T 中可见）
+    int policy;           // SCHED_OTHER / SCHED_FIFO / SCHED_RR
+    int rt_priority;      // 实时优先级（SCHED_FIFO/SCHED_RR时有效，1~99）
+    int nice;             // nice值（SCHED_OTHER时有效）
+    uint32_t cpu_mask;    // 绑定的CPU集合（bit i 表示 CPU i），0表示不绑定
+};
+
+void thread_policy_set(enum thread_role role, const struct thread_policy* policy); // 覆盖默认策略（在创建线程之前调用）
+int thread_policy_apply(enum thread_role role);   // 在线程内调用：命名、绑核、设置调度策略，并登记到统计
+void thread_policy_exit(void);                    // 线程退出前调用：记录最终的CPU时间和上下文切换次数
+void thread_policy_suspend(void);                 // 创建会启动内部线程的库对象（编码器）前调用：临时切回普通调度、不绑核
+void thread_policy_resume(void);                  // 创建完成后调用：恢复当前线程角色的策略
+void thread_policy_lock_memory(void);             // 流水线缓冲区分配完、进入主循环前调用一次：锁定进程当前的内存（避免缺页造成实时线程抖动）
+void thread_policy_report(void);                  // 打印各线程的CPU时间与上下文切换
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // THREAD_POLICY_H
@@ -0,0 +1,47 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "../include/common.h"
+#include <signal.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+* 阶段耗时追踪：输出Chrome trace JSON（chrome://tracing 或 ui.perfetto.dev 直接打开）
+* - 每个线程一个单写者环形缓冲区，记录时不加锁、不分配内存；环满时丢弃并计数
+* - 后台线程周期性取出事件写文件
+* - 每段带帧序号，主线程各阶段与检测线程中同一帧的处理可以对上
+* - 未启用时trace_begin只读一个标志，开销可以忽略
+*/
+
+#define TRACE_RING_SIZE   4096   // 每个线程的事件槽数（2的幂）
+#define TRACE_MAX_THREADS 16     // 参与追踪的线程上限
+#define TRACE_FLUSH_MS    200    // 后台写文件周期
+
+extern int trace_on;   // 当前是否记录（trace_set_enabled修改）
+
+int trace_start(const char* path, bool enabled);   // 打开输出文件并启动写文件线程，0 成功, -1 失败
+void trace_stop(void);                            // 写出剩余事件并关闭文件
+void trace_set_enabled(bool enabled);             // 运行时开关（文件保持打开，关闭期间不记录）
+void trace_toggle_on_signal(int signo);           // 收到该信号时切换开关（如SIGUSR2）
+void trace_record(const char* name, uint32_t seq, int64_t start_ns, int64_t end_ns); // 记录一段（name须为常量字符串）
+
+// 一段的开始：返回开始时间，未启用时返回0
+static inline int64_t trace_begin(void) {
+    return __atomic_load_n(&trace_on, __ATOMIC_RELAXED) ? monotonic_ns() : 0;
+}
+
+// 一段的结束：start_ns为0（开始时未启用）时不记录
+static inline void trace_end(const char* name, uint32_t seq, int64_t start_ns) {
+    if (start_ns) {
+        trace_record(name, seq, start_ns, monotonic_ns());
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_H
@@ -14,12 +14,27 @@ struct v4l2_capture {
     struct buffer *buffers;
     uint32_t width;
     uint32_t height;
-    uint32_t pitch;          // 摄像头行步长
+    uint32_t pitch;          // 摄像头行步长（驱动给出的bytesperline，可能大于宽度）
+    uint32_t uv_offset;      // UV平面相对缓冲区起点的偏移（pitch * height）
     unsigned int n_buffers;  // 缓冲区数量
     uint32_t pix_format;     // 像素格式
+
+    // 文件源：dev是普通文件时，按帧率循环读取其中紧凑排列的NV12原始帧（无摄像头时测试用）
+    int file_fps;            // 文件源帧率（调用方在v4l2_init之前设置，0表示30）
+    bool is_file;
+    size_t frame_bytes;      // 每帧字节数
+    uint64_t file_frames;    // 文件中的帧数
+    int64_t period_ns;       // 帧间隔
+    int64_t start_tick;      // 第一帧所在的时间格
+    int64_t last_tick;       // 上一次出队的时间格
 };
 
 int v4l2_init(struct v4l2_capture *vcap, const char *dev, uint32_t width, uint32_t height, uint32_t buffer_count) ;
 void v4l2_destroy(struct v4l2_capture *vcap);
+int v4l2_wait(struct v4l2_capture *vcap, int timeout_ms);                                        // 等待下一帧，0 就绪, 1 超时, -1 失败
+int v4l2_dequeue(struct v4l2_capture *vcap, struct v4l2_buffer *buf, struct frame_meta *meta); // 出队并取出帧元数据
+int v4l2_requeue(struct v4l2_capture *vcap, struct v4l2_buffer *buf);                          // 重新入队
+void v4l2_frame(const struct v4l2_capture *vcap, const struct v4l2_buffer *buf,
+                const struct frame_meta *meta, struct frame_desc *frame);                      // 出队缓冲区的帧描述（按驱动给出的布局）
 
 #endif // V4L2_H
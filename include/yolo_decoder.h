@@ -0,0 +1,269 @@
+#ifndef _YOLO_DECODER
+#define _YOLO_DECODER
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+#ifdef YOLO_DECODER_HOST   // 主机测试（tools/decoder_test.cpp）：不依赖SDK头文件
+#include <cstddef>
+#include <cstdint>
+enum typecode_t { dt_uint8, dt_int8, dt_float32 };
+typedef struct FrameSize { size_t width; size_t height; } FrameSize;
+#else
+#include "utils.h"
+#endif
+
+/**
+ * @brief 检测框信息
+ */
+typedef struct BoxInfo
+{
+    float x1;   // 检测框左上顶点x坐标
+    float y1;   // 检测框左上顶点y坐标
+    float x2;   // 检测框右下顶点x坐标
+    float y2;   // 检测框右下顶点y坐标
+    float score;    // 检测框的得分
+    int label;  // 检测框的标签
+} BoxInfo;
+
+/**
+ * @brief 输出头的数据类型与量化参数
+ * kmodel的输出可以保留为int8/uint8（不在模型末尾反量化），实际值 = (q - zero_point) * scale；
+ * float输出时scale/zero_point不使用
+ */
+typedef struct HeadQuant
+{
+    typecode_t type;    // dt_float32 / dt_int8 / dt_uint8
+    float scale;        // 量化步长
+    int zero_point;     // 零点
+} HeadQuant;
+
+/**
+ * @brief 输出头格式
+ */
+enum class HeadFormat
+{
+    AnchorV5,       // YOLOv5：3个NHWC输出头 [1, H, W, A*(5+nc)]，每个锚框 x,y,w,h,obj,cls...（已sigmoid）
+    AnchorFreeV8,   // YOLOv8：1个输出 [1, 4+nc, N]，cx,cy,w,h（输入像素）+ 各类得分，无objectness
+};
+
+/**
+ * @brief 一个输出头的几何信息
+ */
+typedef struct HeadDesc
+{
+    int stride;                 // AnchorV5: 下采样倍数
+    int grid_w, grid_h;         // AnchorV5: 网格大小
+    const float (*anchors)[2];  // AnchorV5: 该头的锚框
+    int num_boxes;              // AnchorFreeV8: 候选框个数
+} HeadDesc;
+
+/**
+ * @brief letterbox参数：按比例缩放后居中，上下/左右按整数像素填充（ai2d的填充参数与解码时的坐标换算共用）
+ */
+typedef struct Letterbox
+{
+    float gain;                     // 缩放比例
+    int left, top, right, bottom;   // 各边填充（像素）
+} Letterbox;
+
+static inline Letterbox make_letterbox(int net_w, int net_h, size_t width, size_t height)
+{
+    Letterbox lb;
+    lb.gain = std::min((float)net_w / width, (float)net_h / height);
+    float dw = (net_w - (int)(width * lb.gain)) / 2.0f;
+    float dh = (net_h - (int)(height * lb.gain)) / 2.0f;
+    lb.top = (int)std::round(dh - 0.1f);
+    lb.bottom = (int)std::round(dh + 0.1f);
+    lb.left = (int)std::round(dw - 0.1f);
+    lb.right = (int)std::round(dw + 0.1f);
+    return lb;
+}
+
+/**
+ * @brief 解码参数（对所有输出头相同）
+ */
+typedef struct DecodeParams
+{
+    int net_w, net_h;       // 模型输入大小
+    int num_classes;        // 类别数（通用解码器使用）
+    FrameSize frame;        // 原图大小
+    float threshold;        // 得分阈值
+    Letterbox lb;           // 预处理实际使用的letterbox（make_letterbox）
+} DecodeParams;
+
+typedef void (*DecodeFn)(const void *data, const HeadQuant &q, const HeadDesc &head, const DecodeParams &p, std::vector<BoxInfo> &out);
+
+/**
+ * @brief 解码器注册项：按格式、类别数、输出数据类型编译期特化，num_classes为0表示通用版本（运行时类别数）
+ */
+typedef struct DecoderEntry
+{
+    HeadFormat format;
+    int num_classes;
+    typecode_t type;
+    DecodeFn fn;
+    const char *name;
+} DecoderEntry;
+
+/**
+ * @brief 根据kmodel输出形状判断输出头格式与类别数
+ * @param output_shapes kmodel的输出形状
+ * @param format        输出头格式
+ * @param num_classes   类别数
+ * @return 是否识别
+ */
+bool detect_head_format(const std::vector<std::vector<int>> &output_shapes, HeadFormat &format, int &num_classes);
+
+/**
+ * @brief 选择解码器：优先使用类别数完全匹配的特化版本，没有时使用通用版本
+ * @return 注册项，格式或数据类型不支持时返回nullptr
+ */
+const DecoderEntry *select_decoder(HeadFormat format, int num_classes, typecode_t type);
+
+// ---------------------------------------------------------------------------------
+// 以下为解码器模板（yolo_decoder.cpp中实例化并注册）
+
+// 反量化与量化域门限：float输出不做任何换算
+template <typename T>
+struct QuantTraits
+{
+    static inline float value(T v, const HeadQuant &q) { return (v - q.zero_point) * q.scale; }
+    // 满足 value(v) <= limit 的最大量化值 / 满足 value(v) >= limit 的最小量化值
+    static inline int gate(float limit, const HeadQuant &q) { return (int)std::floor(limit / q.scale) + q.zero_point; }
+    static inline int gate_low(float limit, const HeadQuant &q) { return (int)std::ceil(limit / q.scale) + q.zero_point; }
+    static inline float max_value(const HeadQuant &q) { return value(std::numeric_limits<T>::max(), q); }
+    static inline float min_value(const HeadQuant &q) { return value(std::numeric_limits<T>::min(), q); }
+};
+
+template <>
+struct QuantTraits<float>
+{
+    static inline float value(float v, const HeadQuant &) { return v; }
+};
+
+// 网络输入坐标（中心点、宽高）换算回原图（按预处理实际的整数填充）
+static inline BoxInfo net_to_frame_box(float cx, float cy, float bw, float bh, const DecodeParams &p)
+{
+    const float gain = p.lb.gain;
+    cx -= p.lb.left;
+    cy -= p.lb.top;
+    cx /= gain;
+    cy /= gain;
+    bw /= gain;
+    bh /= gain;
+    BoxInfo box;
+    box.x1 = std::max(0, std::min<int>(p.frame.width, int(cx - bw / 2.f)));
+    box.y1 = std::max(0, std::min<int>(p.frame.height, int(cy - bh / 2.f)));
+    box.x2 = std::max(0, std::min<int>(p.frame.width, int(cx + bw / 2.f)));
+    box.y2 = std::max(0, std::min<int>(p.frame.height, int(cy + bh / 2.f)));
+    return box;
+}
+
+/**
+ * @brief YOLOv5锚框输出头解码（NHWC）
+ * NC、NA为编译期常量时内层循环完全展开；NC为0时使用运行时类别数。
+ * 量化输出时 score = cls * obj 不超过 obj * cls_max（obj >= 0）或 obj * cls_min（obj < 0，零点使量化范围包含负值时），
+ * 先用整数比较objectness，不可能超过阈值的候选（绝大多数）不做任何反量化；
+ * 门限各收紧一个量化步长，浮点舍入不会让本应保留的候选被跳过
+ */
+template <typename T, int NC, int NA>
+void decode_anchor_v5(const void *data, const HeadQuant &q, const HeadDesc &head, const DecodeParams &p, std::vector<BoxInfo> &out)
+{
+    typedef QuantTraits<T> QT;
+    const T *base = static_cast<const T *>(data);
+    const int nc = NC > 0 ? NC : p.num_classes;
+    const int one_rsize = nc + 5;
+    // objectness量化值在[obj_lo, obj_hi]内时任何类别的得分都不会超过阈值
+    [[maybe_unused]] int obj_lo = std::numeric_limits<int>::max(), obj_hi = std::numeric_limits<int>::min();
+    if constexpr (!std::is_same<T, float>::value)
+    {
+        if (p.threshold >= 0)
+        {
+            float cls_max = QT::max_value(q);
+            float cls_min = QT::min_value(q);
+            obj_hi = cls_max > 0 ? QT::gate(p.threshold / cls_max, q) - 1 : std::numeric_limits<int>::max();
+            obj_lo = cls_min < 0 ? QT::gate_low(p.threshold / cls_min, q) + 1 : std::numeric_limits<int>::min();
+        }
+    }
+    for (int shift_y = 0; shift_y < head.grid_h; shift_y++)
+    {
+        for (int shift_x = 0; shift_x < head.grid_w; shift_x++)
+        {
+            const T *cell = base + (shift_x + shift_y * head.grid_w) * NA * one_rsize;
+#pragma GCC unroll 4
+            for (int i = 0; i < NA; i++)
+            {
+                const T *record = cell + i * one_rsize;
+                if constexpr (!std::is_same<T, float>::value)
+                {
+                    if (record[4] >= obj_lo && record[4] <= obj_hi)
+                    {
+                        continue;
+                    }
+                }
+                float obj = QT::value(record[4], q);
+                const T *cls_ptr = record + 5;
+#pragma GCC unroll 16
+                for (int cls = 0; cls < nc; cls++)
+                {
+                    // float score = sigmoid(cls_ptr[cls]) * sigmoid(record[4]);
+                    float score = QT::value(cls_ptr[cls], q) * obj;
+                    if (score > p.threshold)
+                    {
+                        float cx = (QT::value(record[0], q) * 2.f - 0.5f + (float)shift_x) * (float)head.stride;
+                        float cy = (QT::value(record[1], q) * 2.f - 0.5f + (float)shift_y) * (float)head.stride;
+                        float bw = pow(QT::value(record[2], q) * 2.f, 2) * head.anchors[i][0];
+                        float bh = pow(QT::value(record[3], q) * 2.f, 2) * head.anchors[i][1];
+                        BoxInfo box = net_to_frame_box(cx, cy, bw, bh, p);
+                        box.score = score;
+                        box.label = cls;
+                        out.push_back(box);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief YOLOv8无锚框输出解码（[1, 4+nc, N]，按通道存放）
+ * 每个候选取得分最高的类别；量化输出时直接比较整数（得分单调），超过阈值的才反量化
+ */
+template <typename T, int NC>
+void decode_anchor_free_v8(const void *data, const HeadQuant &q, const HeadDesc &head, const DecodeParams &p, std::vector<BoxInfo> &out)
+{
+    typedef QuantTraits<T> QT;
+    const T *base = static_cast<const T *>(data);
+    const int nc = NC > 0 ? NC : p.num_classes;
+    const int n = head.num_boxes;
+    for (int j = 0; j < n; j++)
+    {
+        const T *cls_ptr = base + 4 * n + j;
+        T best = cls_ptr[0];
+        int best_cls = 0;
+#pragma GCC unroll 16
+        for (int cls = 1; cls < nc; cls++)
+        {
+            T v = cls_ptr[cls * n];
+            if (v > best)
+            {
+                best = v;
+                best_cls = cls;
+            }
+        }
+        float score = QT::value(best, q);
+        if (score > p.threshold)
+        {
+            BoxInfo box = net_to_frame_box(QT::value(base[j], q), QT::value(base[n + j], q),
+                                           QT::value(base[2 * n + j], q), QT::value(base[3 * n + j], q), p);
+            box.score = score;
+            box.label = best_cls;
+            out.push_back(box);
+        }
+    }
+}
+
+#endif
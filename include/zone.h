@@ -0,0 +1,52 @@
+#ifndef ZONE_H
+#define ZONE_H
+
+#include "../include/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ZONE_MAX        8    // 区域数上限（位图每格一个字节，bit i 表示位于区域 i 内）
+#define ZONE_MAX_POINTS 16   // 每个多边形的顶点数上限
+
+// 检测区域（多边形，坐标为0~1的归一化值，与分辨率无关）
+struct zone {
+    char name[32];
+    bool exclude;                        // 排除区（如人行道）：与之重叠达到min_overlap的框丢弃
+    float min_score;                     // 区域内的得分阈值（可低于全局阈值）
+    float min_overlap;                   // 框面积中落在区域内的比例下限（0~1）
+    int npoints;
+    float points[ZONE_MAX_POINTS][2];
+};
+
+// 区域位图：加载时栅格化一次，每个区域一张积分图，每个框对每个区域的判定都是常数时间
+struct zone_map {
+    int width, height;          // 框坐标所在的分辨率（帧分辨率）
+    int cell;                   // 栅格大小（像素），1表示按帧分辨率栅格化
+    int grid_w, grid_h;         // 位图尺寸
+    int count;                  // 区域数，0表示不过滤
+    int include_count;          // 非排除区的数量（有包含区时，不在任何包含区内的框丢弃）
+    uint8_t exclude_bits;       // 排除区对应的位
+    struct zone zones[ZONE_MAX];
+    uint8_t* mask;              // grid_w*grid_h，bit i 表示该格在区域 i 内
+    uint32_t* integral[ZONE_MAX]; // (grid_w+1)*(grid_h+1) 积分图
+};
+
+/*
+* 从文件加载区域，每行一个区域：
+*   名称 include|exclude 得分阈值 最小重叠 x1,y1 x2,y2 x3,y3 ...
+* 坐标为0~1的归一化值，#开头为注释
+*/
+int zone_map_load(struct zone_map* zm, const char* path, int width, int height, int cell);
+void zone_map_free(struct zone_map* zm);
+float zone_map_min_score(const struct zone_map* zm, float default_thresh); // 解码阈值（所有区域与全局阈值中的最小值）
+// 判断一个框是否保留（坐标为width x height下的像素坐标），default_thresh用于不在任何区域内的框
+bool zone_map_accept(const struct zone_map* zm, float x1, float y1, float x2, float y2, float score, float default_thresh);
+bool zone_map_ignored(const struct zone_map* zm, int x, int y); // 该像素是否被屏蔽（在排除区内，或有包含区时不在任何包含区内）
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ZONE_H
@@ -0,0 +1,67 @@
+#include "dual_capture.h"
+
+void dual_capture_init(struct dual_capture* dc, struct v4l2_capture* sub, int max_skew_ms) {
+    dc->sub = sub;
+    dc->max_skew_ns = (int64_t)max_skew_ms * 1000000LL;
+    dc->held = false;
+    dc->paired = dc->unpaired = dc->sub_dropped = 0;
+}
+
+int dual_capture_release(struct dual_capture* dc) {
+    if (!dc->held) return 0;
+    dc->held = false;
+    return v4l2_requeue(dc->sub, &dc->sub_buf);
+}
+
+void dual_capture_reset(struct dual_capture* dc) {
+    dc->held = false;  // 重新初始化后旧缓冲区已失效，不再入队
+}
+
+/*
+* 配对规则：
+* - 持有的子码流帧比主码流帧新（超过max_skew）：留给下一个主码流帧，本帧不配对
+* - 在max_skew以内：配对
+* - 比主码流帧旧：入队，继续取下一帧（子码流积压时一次追上）
+* 子码流可能比主码流稍晚到达，没有帧时最多等待max_skew
+*/
+int dual_capture_pair(struct dual_capture* dc, const struct frame_meta* main_meta, struct frame_desc* sub) {
+    int64_t t = main_meta->capture_ns;
+    int wait_ms = (int)(dc->max_skew_ns / 1000000LL);
+    if (wait_ms < 1) wait_ms = 1;
+    for (;;) {
+        if (dc->held) {
+            int64_t d = dc->sub_meta.capture_ns - t;
+            if (d > dc->max_skew_ns) {
+                dc->unpaired++;
+                return 1;
+            }
+            if (d >= -dc->max_skew_ns) {
+                v4l2_frame(dc->sub, &dc->sub_buf, &dc->sub_meta, sub);
+                dc->paired++;
+                return 0;
+            }
+            dc->sub_dropped++;
+            if (dual_capture_release(dc) != 0) {
+                return -1;
+            }
+        }
+        int r = v4l2_wait(dc->sub, wait_ms);
+        if (r == 0) {
+            r = v4l2_dequeue(dc->sub, &dc->sub_buf, &dc->sub_meta);
+        }
+        if (r > 0) {
+            dc->unpaired++;
+            return 1;
+        }
+        if (r < 0) {
+            return -1;
+        }
+        dc->held = true;
+    }
+}
+
+void dual_capture_report(struct dual_capture* dc) {
+    printf("[双码流] 配对%llu帧 未配对%llu帧 子码流丢弃%llu帧\n",
+           (unsigned long long)dc->paired, (unsigned long long)dc->unpaired,
+           (unsigned long long)dc->sub_dropped);
+}
@@ -0,0 +1,163 @@
+#include "eptz.h"
+
+#define EPTZ_REDRAW_PX 2   // 取景框移动超过该像素数（采集帧坐标）时重画叠加层上的框
+
+// 全景时的取景框宽度（显示宽高比与采集帧不同时取能放进帧内的最大宽度）
+static float full_width(const struct eptz* ez) {
+    float w = (float)ez->src_height * ez->out_width / ez->out_height;
+    return w < ez->src_width ? w : (float)ez->src_width;
+}
+
+void eptz_init(struct eptz* ez) {
+    pthread_mutex_init(&ez->lock, NULL);
+    ez->box_count = 0;
+    ez->last_seen_ns = 0;
+    ez->boxes_changed = false;
+    ez->cx = ez->tcx = ez->src_width / 2.0f;
+    ez->cy = ez->tcy = ez->src_height / 2.0f;
+    ez->w = ez->tw = full_width(ez);
+    ez->last_step_ns = 0;
+    ez->drawn_x = ez->drawn_y = ez->drawn_w = 0;
+    ez->drawn_count = 0;
+    fprintf(stderr, "ePTZ: %dx%d -> %dx%d 最大放大%.1f倍\n", ez->src_width, ez->src_height,
+            ez->out_width, ez->out_height, ez->max_zoom);
+}
+
+void eptz_destroy(struct eptz* ez) {
+    pthread_mutex_destroy(&ez->lock);
+}
+
+void eptz_update_detections(struct eptz* ez, const struct all_det_location* all_loc) {
+    pthread_mutex_lock(&ez->lock);
+    int n = all_loc ? all_loc->count : 0;
+    if (n > EPTZ_MAX_BOXES) n = EPTZ_MAX_BOXES;
+    for (int i = 0; i < n; i++) {
+        ez->boxes[i] = *all_loc->locations[i];
+    }
+    ez->box_count = n;
+    if (n > 0) {
+        ez->last_seen_ns = monotonic_ns();
+    }
+    ez->boxes_changed = true;
+    pthread_mutex_unlock(&ez->lock);
+}
+
+/*
+* 目标取景框：检测框并集外扩margin，扩展到显示宽高比，宽度限制在[全景/max_zoom, 全景]；
+* 超过hold_ms没有人时回到全景
+*/
+static void update_target(struct eptz* ez, int64_t now) {
+    float full = full_width(ez);
+    pthread_mutex_lock(&ez->lock);
+    int n = ez->box_count;
+    bool seen = ez->last_seen_ns && now - ez->last_seen_ns < (int64_t)ez->hold_ms * 1000000LL;
+    float x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+    for (int i = 0; i < n; i++) {
+        const struct det_location* b = &ez->boxes[i];
+        if (i == 0 || b->x1 < x1) x1 = b->x1;
+        if (i == 0 || b->y1 < y1) y1 = b->y1;
+        if (i == 0 || b->x2 > x2) x2 = b->x2;
+        if (i == 0 || b->y2 > y2) y2 = b->y2;
+    }
+    pthread_mutex_unlock(&ez->lock);
+
+    if (!seen) {
+        ez->tcx = ez->src_width / 2.0f;
+        ez->tcy = ez->src_height / 2.0f;
+        ez->tw = full;
+        return;
+    }
+    if (n == 0) {
+        return;  // 人暂时没检测到（漏检）：保持上一个目标，hold_ms后回到全景
+    }
+    float bw = (x2 - x1) * (1.0f + 2 * ez->margin);
+    float bh = (y2 - y1) * (1.0f + 2 * ez->margin);
+    float aspect = (float)ez->out_width / ez->out_height;
+    float w = bw > bh * aspect ? bw : bh * aspect;
+    float min_w = full / (ez->max_zoom > 1.0f ? ez->max_zoom : 1.0f);
+    if (w < min_w) w = min_w;
+    if (w > full) w = full;
+    float cx = (x1 + x2) / 2, cy = (y1 + y2) / 2;
+    if (fabsf(cx - ez->tcx) >= ez->deadband || fabsf(cy - ez->tcy) >= ez->deadband ||
+        fabsf(w - ez->tw) >= ez->deadband) {
+        ez->tcx = cx;
+        ez->tcy = cy;
+        ez->tw = w;
+    }
+}
+
+/*
+* 推进一帧：取景框按指数平滑靠近目标（与帧率无关，按实际经过时间计算），
+* 再限制在帧内并对齐到偶数（NV12）
+*/
+struct frame_desc eptz_step(struct eptz* ez, const struct frame_desc* src, bool* redraw) {
+    int64_t now = monotonic_ns();
+    update_target(ez, now);
+    float alpha = 0.0f;
+    if (ez->last_step_ns) {
+        float dt_ms = (now - ez->last_step_ns) / 1e6f;
+        alpha = ez->smooth_ms > 0 ? 1.0f - expf(-dt_ms / ez->smooth_ms) : 1.0f;
+    }
+    ez->last_step_ns = now;
+    ez->cx += (ez->tcx - ez->cx) * alpha;
+    ez->cy += (ez->tcy - ez->cy) * alpha;
+    ez->w += (ez->tw - ez->w) * alpha;
+
+    int w = (int)ez->w & ~1;
+    int h = (int)(ez->w * ez->out_height / ez->out_width) & ~1;
+    if (w > ez->src_width) w = ez->src_width & ~1;
+    if (h > ez->src_height) h = ez->src_height & ~1;
+    int x = (int)(ez->cx - w / 2.0f);
+    int y = (int)(ez->cy - h / 2.0f);
+    if (x > ez->src_width - w) x = ez->src_width - w;
+    if (y > ez->src_height - h) y = ez->src_height - h;
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    ez->crop_x = x & ~1;
+    ez->crop_y = y & ~1;
+    ez->crop_w = w;
+    ez->crop_h = h;
+
+    pthread_mutex_lock(&ez->lock);
+    bool changed = ez->boxes_changed;
+    bool has_boxes = ez->box_count > 0;
+    pthread_mutex_unlock(&ez->lock);
+    bool moved = abs(ez->crop_x - ez->drawn_x) + abs(ez->crop_y - ez->drawn_y) +
+                 abs(ez->crop_w - ez->drawn_w) > EPTZ_REDRAW_PX;
+    *redraw = changed || (moved && (has_boxes || ez->drawn_count > 0));
+    return frame_desc_crop(src, ez->crop_x, ez->crop_y, ez->crop_w, ez->crop_h);
+}
+
+int eptz_map_boxes(struct eptz* ez, struct det_location* out, int max) {
+    struct det_location boxes[EPTZ_MAX_BOXES];
+    pthread_mutex_lock(&ez->lock);
+    int n = ez->box_count < max ? ez->box_count : max;
+    memcpy(boxes, ez->boxes, sizeof(boxes[0]) * n);
+    ez->boxes_changed = false;
+    pthread_mutex_unlock(&ez->lock);
+
+    float sx = (float)ez->out_width / ez->crop_w, sy = (float)ez->out_height / ez->crop_h;
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        int x1 = (int)((boxes[i].x1 - ez->crop_x) * sx);
+        int y1 = (int)((boxes[i].y1 - ez->crop_y) * sy);
+        int x2 = (int)((boxes[i].x2 - ez->crop_x) * sx);
+        int y2 = (int)((boxes[i].y2 - ez->crop_y) * sy);
+        if (x1 < 0) x1 = 0;
+        if (y1 < 0) y1 = 0;
+        if (x2 > ez->out_width - 1) x2 = ez->out_width - 1;
+        if (y2 > ez->out_height - 1) y2 = ez->out_height - 1;
+        if (x2 <= x1 || y2 <= y1) continue;   // 完全在取景框外
+        out[count] = boxes[i];
+        out[count].x1 = x1;
+        out[count].y1 = y1;
+        out[count].x2 = x2;
+        out[count].y2 = y2;
+        count++;
+    }
+    ez->drawn_x = ez->crop_x;
+    ez->drawn_y = ez->crop_y;
+    ez->drawn_w = ez->crop_w;
+    ez->drawn_count = count;
+    return count;
+}
@@ -0,0 +1,175 @@
+#include "event_index.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+void event_index_path(char* out, size_t size, const char* media_path) {
+    const char* dot = strrchr(media_path, '.');
+    const char* slash = strrchr(media_path, '/');
+    int base_len = (dot && (!slash || dot > slash)) ? (int)(dot - media_path) : (int)strlen(media_path);
+    snprintf(out, size, "%.*s" EVENT_INDEX_SUFFIX, base_len, media_path);
+}
+
+// 追加一条记录（O_APPEND，单次write，掉电最多丢最后一条）
+static int event_index_append(struct event_index_writer* w, const struct event_index_record* rec) {
+    if (w->fd < 0) return -1;
+    ssize_t n;
+    do {
+        n = write(w->fd, rec, sizeof(*rec));
+    } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t)sizeof(*rec)) {
+        fprintf(stderr, "事件索引写入失败: %s\n", n < 0 ? strerror(errno) : "short write");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+* 创建索引文件
+* @media_path: 录像文件路径，索引与其同名（后缀换成.idx）；录像文件名唯一，已存在同名索引时不覆盖
+* @return: 0 成功, -1 失败
+*/
+int event_index_create(struct event_index_writer* w, const char* media_path,
+                       int64_t start_realtime_ms, uint32_t interval_ms) {
+    event_index_path(w->path, sizeof(w->path), media_path);
+    w->fd = open(w->path, O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+    if (w->fd < 0) {
+        fprintf(stderr, "无法创建事件索引%s: %s\n", w->path, strerror(errno));
+        return -1;
+    }
+    struct event_index_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, EVENT_INDEX_MAGIC, sizeof(hdr.magic));
+    hdr.version = EVENT_INDEX_VERSION;
+    hdr.record_size = sizeof(struct event_index_record);
+    hdr.start_realtime_ms = start_realtime_ms;
+    hdr.interval_ms = interval_ms;
+    if (write(w->fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr)) {
+        fprintf(stderr, "事件索引写入失败: %s\n", w->path);
+        close(w->fd);
+        w->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+int event_index_add_keyframe(struct event_index_writer* w, int64_t pts_ms, uint64_t offset) {
+    struct event_index_record rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.pts_ms = pts_ms;
+    rec.offset = offset;
+    rec.type = EVENT_KEYFRAME;
+    return event_index_append(w, &rec);
+}
+
+int event_index_add_detect(struct event_index_writer* w, int64_t pts_ms, int duration_ms,
+                           const struct event_summary* s) {
+    struct event_index_record rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.pts_ms = pts_ms;
+    rec.type = EVENT_DETECT;
+    rec.count = s->count > 255 ? 255 : s->count;
+    rec.max_score = (uint16_t)(s->max_score * 1000);
+    rec.duration_ms = duration_ms > 65535 ? 65535 : duration_ms;
+    rec.box[0] = s->x1;
+    rec.box[1] = s->y1;
+    rec.box[2] = s->x2;
+    rec.box[3] = s->y2;
+    return event_index_append(w, &rec);
+}
+
+void event_index_close(struct event_index_writer* w) {
+    if (w->fd < 0) return;
+    close(w->fd);
+    w->fd = -1;
+}
+
+void event_summary_add(struct event_summary* s, int x1, int y1, int x2, int y2, float score) {
+    if (s->max_score <= 0) {
+        s->x1 = x1; s->y1 = y1; s->x2 = x2; s->y2 = y2;
+    } else {
+        if (x1 < s->x1) s->x1 = x1;
+        if (y1 < s->y1) s->y1 = y1;
+        if (x2 > s->x2) s->x2 = x2;
+        if (y2 > s->y2) s->y2 = y2;
+    }
+    if (score > s->max_score) s->max_score = score;
+}
+
+/*
+* 只读映射索引文件
+* @return: 0 成功, -1 失败（文件不存在或格式不符）
+*/
+int event_index_map(struct event_index* idx, const char* path) {
+    memset(idx, 0, sizeof(*idx));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(struct event_index_header)) {
+        close(fd);
+        return -1;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    const struct event_index_header* hdr = (const struct event_index_header*)map;
+    if (memcmp(hdr->magic, EVENT_INDEX_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != EVENT_INDEX_VERSION ||
+        hdr->record_size != sizeof(struct event_index_record)) {
+        fprintf(stderr, "%s: 不是有效的事件索引\n", path);
+        munmap(map, st.st_size);
+        return -1;
+    }
+    idx->map = map;
+    idx->map_size = st.st_size;
+    idx->header = hdr;
+    idx->records = (const struct event_index_record*)(hdr + 1);
+    idx->count = (st.st_size - sizeof(*hdr)) / sizeof(struct event_index_record);
+    return 0;
+}
+
+void event_index_unmap(struct event_index* idx) {
+    if (idx->map) {
+        munmap(idx->map, idx->map_size);
+    }
+    memset(idx, 0, sizeof(*idx));
+}
+
+size_t event_index_lower_bound(const struct event_index* idx, int64_t pts_ms) {
+    size_t lo = 0, hi = idx->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (idx->records[mid].pts_ms < pts_ms) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+const struct event_index_record* event_index_keyframe_at(const struct event_index* idx, int64_t pts_ms) {
+    // 先找到第一条 > pts_ms 的记录，再向前找关键帧（最多回退一个GOP内的记录）
+    size_t i = event_index_lower_bound(idx, pts_ms + 1);
+    while (i > 0) {
+        i--;
+        if (idx->records[i].type == EVENT_KEYFRAME) return &idx->records[i];
+    }
+    return NULL;
+}
+
+const struct event_index_record* event_index_keyframe_after(const struct event_index* idx, int64_t pts_ms) {
+    for (size_t i = event_index_lower_bound(idx, pts_ms); i < idx->count; i++) {
+        if (idx->records[i].type == EVENT_KEYFRAME) return &idx->records[i];
+    }
+    return NULL;
+}
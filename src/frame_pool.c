@@ -0,0 +1,146 @@
+#include "frame_pool.h"
+
+#ifdef USE_MMZ
+#include <mmz.h>
+#endif
+
+// 分配一块帧内存，MMZ不可用时退回malloc
+static int frame_mem_alloc(struct frame_pool* pool, struct pool_frame* f) {
+#ifdef USE_MMZ
+    if (pool->use_mmz) {
+        void* virt = NULL;
+        uint64_t phys = 0;
+        if (kd_mpi_sys_mmz_alloc_cached(&phys, &virt, pool->name, "anonymous", pool->frame_size) == 0) {
+            f->virt = (uint8_t*)virt;
+            f->phys = phys;
+            return 0;
+        }
+        fprintf(stderr, "MMZ分配失败(%s)，帧池改用malloc\n", pool->name);
+        pool->use_mmz = false;
+    }
+#endif
+    void* mem = NULL;
+    if (posix_memalign(&mem, 4096, pool->frame_size) != 0) {
+        return -1;
+    }
+    f->virt = (uint8_t*)mem;
+    f->phys = 0;
+    return 0;
+}
+
+static void frame_mem_free(struct frame_pool* pool, struct pool_frame* f) {
+    if (!f->virt) return;
+#ifdef USE_MMZ
+    if (f->phys) {
+        kd_mpi_sys_mmz_free(f->phys, f->virt);
+        f->virt = NULL;
+        return;
+    }
+#endif
+    (void)pool;
+    free(f->virt);
+    f->virt = NULL;
+}
+
+/*
+* 初始化帧池
+* @name: 帧池名（MMZ中的mmb名，便于在/proc/media-mem中查看）
+* @frame_size: 每帧字节数
+* @count: 帧数量（固定，运行中不再增加）
+* @return: 0 成功, -1 失败
+*/
+int frame_pool_init(struct frame_pool* pool, const char* name, size_t frame_size, unsigned int count) {
+    if (!pool || frame_size == 0 || count == 0) {
+        return -1;
+    }
+    memset(pool, 0, sizeof(*pool));
+    pool->name = name;
+    pool->frame_size = frame_size;
+    pool->count = count;
+#ifdef USE_MMZ
+    pool->use_mmz = true;
+#endif
+    pool->frames = calloc(count, sizeof(struct pool_frame));
+    pool->free_list = calloc(count, sizeof(unsigned int));
+    if (!pool->frames || !pool->free_list) {
+        perror("帧池结构体分配失败");
+        goto error;
+    }
+    for (unsigned int i = 0; i < count; i++) {
+        struct pool_frame* f = &pool->frames[i];
+        f->pool = pool;
+        f->index = i;
+        f->size = frame_size;
+        if (frame_mem_alloc(pool, f) != 0) {
+            fprintf(stderr, "帧池%s第%u帧分配失败\n", name, i);
+            goto error;
+        }
+        pool->free_list[pool->free_count++] = i;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    fprintf(stderr, "帧池%s: %u x %zu bytes (%s)\n", name, count, frame_size,
+            pool->use_mmz ? "MMZ" : "malloc");
+    return 0;
+error:
+    if (pool->frames) {
+        for (unsigned int i = 0; i < count; i++) {
+            frame_mem_free(pool, &pool->frames[i]);
+        }
+    }
+    free(pool->frames);
+    free(pool->free_list);
+    pool->frames = NULL;
+    pool->free_list = NULL;
+    return -1;
+}
+
+void frame_pool_destroy(struct frame_pool* pool) {
+    if (!pool || !pool->frames) return;
+    if (pool->free_count != pool->count) {
+        fprintf(stderr, "警告：帧池%s销毁时仍有%u帧未归还\n", pool->name, pool->count - pool->free_count);
+    }
+    for (unsigned int i = 0; i < pool->count; i++) {
+        frame_mem_free(pool, &pool->frames[i]);
+    }
+    free(pool->frames);
+    free(pool->free_list);
+    pool->frames = NULL;
+    pool->free_list = NULL;
+    pthread_mutex_destroy(&pool->lock);
+    fprintf(stderr, "帧池%s已释放\n", pool->name);
+}
+
+struct pool_frame* frame_pool_get(struct frame_pool* pool) {
+    struct pool_frame* f = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->free_count > 0) {
+        f = &pool->frames[pool->free_list[--pool->free_count]];
+        __atomic_store_n(&f->refcount, 1, __ATOMIC_RELAXED);
+    } else {
+        pool->exhausted++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return f;
+}
+
+void pool_frame_put(struct pool_frame* f) {
+    if (!f) return;
+    if (__atomic_sub_fetch(&f->refcount, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+    struct frame_pool* pool = f->pool;
+    pthread_mutex_lock(&pool->lock);
+    pool->free_list[pool->free_count++] = f->index;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// K230的MMZ接口只提供flush（写回并失效）；malloc后备时硬件不会直接读这块内存，不需要处理
+void pool_frame_flush(struct pool_frame* f) {
+#ifdef USE_MMZ
+    if (f->phys) {
+        kd_mpi_sys_mmz_flush_cache(f->phys, f->virt, f->size);
+    }
+#else
+    (void)f;
+#endif
+}
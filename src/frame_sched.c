@@ -0,0 +1,164 @@
+#include "frame_sched.h"
+
+#define SCHED_DEFAULT_PERIOD_NS 33333333LL   // 还没有两帧时间戳时按30fps估计
+
+static int64_t fps_to_period(int fps) {
+    return fps > 0 ? 1000000000LL / fps : 0;
+}
+
+static void record_drop(struct frame_sched* fs, enum sched_consumer c,
+                        enum sched_drop_reason reason, int64_t over_ns) {
+    fs->c[c].drops[reason]++;
+    struct sched_drop_record* r = &fs->log[fs->log_head];
+    r->sequence = fs->sequence;
+    r->consumer = c;
+    r->reason = reason;
+    r->over_ns = over_ns;
+    fs->log_head = (fs->log_head + 1) % SCHED_DROP_LOG_SIZE;
+    fs->log_total++;
+}
+
+/*
+* 初始化调度器
+* @loop_fps: 主循环限速帧率，0表示不限速，主循环跟随传感器原生帧率
+*/
+void frame_sched_init(struct frame_sched* fs, int loop_fps) {
+    memset(fs, 0, sizeof(*fs));
+    fs->sensor_period_ns = SCHED_DEFAULT_PERIOD_NS;
+    fs->loop_period_ns = fps_to_period(loop_fps);
+    fs->next_tick_ns = monotonic_ns();
+}
+
+void frame_sched_set_rate(struct frame_sched* fs, enum sched_consumer c, const char* name, int fps, int priority) {
+    struct sched_consumer_state* s = &fs->c[c];
+    s->name = name;
+    s->fps = fps;
+    s->priority = priority;
+    s->period_ns = fps_to_period(fps);
+    s->next_due_ns = 0;
+}
+
+/*
+* 新的一帧开始
+* 1. 用采集时间戳更新传感器帧间隔（即每帧的处理预算）
+* 2. 按各消费者的绝对截止时间判断本帧是否到期
+*/
+void frame_sched_begin(struct frame_sched* fs, const struct frame_meta* meta) {
+    fs->frame_start_ns = monotonic_ns();
+    fs->sequence = meta->sequence;
+    if (fs->last_capture_ns) {
+        int64_t delta = meta->capture_ns - fs->last_capture_ns;
+        if (delta > 0 && delta < 1000000000LL) {
+            fs->sensor_period_ns += (delta - fs->sensor_period_ns) / 8;
+        }
+    }
+    fs->last_capture_ns = meta->capture_ns;
+
+    for (int i = 0; i < SCHED_CONSUMER_NUM; i++) {
+        struct sched_consumer_state* s = &fs->c[i];
+        s->ran = false;
+        if (s->period_ns == 0) {
+            s->due = true;
+            continue;
+        }
+        // 采集时间落在截止时间前半帧以内也算到期，避免时间戳抖动造成误判
+        s->due = meta->capture_ns + fs->sensor_period_ns / 2 >= s->next_due_ns;
+    }
+}
+
+/*
+* 判断消费者本帧是否运行
+* 预算 = 传感器帧间隔。当 已用时间 + 尚未运行的更高优先级消费者的耗时 + 本消费者耗时 超出预算时，
+* 除最高优先级外的消费者放弃本帧，并记录丢帧
+*/
+bool frame_sched_should_run(struct frame_sched* fs, enum sched_consumer c) {
+    struct sched_consumer_state* s = &fs->c[c];
+    if (!s->due) {
+        return false;
+    }
+
+    int64_t reserve = 0;
+    bool highest = true;
+    for (int i = 0; i < SCHED_CONSUMER_NUM; i++) {
+        struct sched_consumer_state* o = &fs->c[i];
+        if (i == (int)c || o->name == NULL) continue;
+        if (o->priority < s->priority) {
+            highest = false;
+            if (o->due && !o->ran) reserve += o->cost_ns;
+        }
+    }
+    int64_t elapsed = monotonic_ns() - fs->frame_start_ns;
+    int64_t over = elapsed + reserve + s->cost_ns - fs->sensor_period_ns;
+    if (!highest && over > 0) {
+        record_drop(fs, c, SCHED_DROP_BUDGET, over);
+        return false;  // 截止时间不前移，下一帧继续尝试
+    }
+
+    s->ran = true;
+    s->runs++;
+    if (s->period_ns) {
+        // 在绝对时间轴上前移截止时间；落后超过一个周期时重新对齐，不做补帧
+        s->next_due_ns += s->period_ns;
+        if (s->next_due_ns < fs->last_capture_ns - s->period_ns) {
+            s->next_due_ns = fs->last_capture_ns + s->period_ns;
+        }
+    }
+    return true;
+}
+
+void frame_sched_done(struct frame_sched* fs, enum sched_consumer c, int64_t cost_ns) {
+    struct sched_consumer_state* s = &fs->c[c];
+    if (s->cost_ns == 0) {
+        s->cost_ns = cost_ns;
+    } else {
+        s->cost_ns += (cost_ns - s->cost_ns) / 8;
+    }
+}
+
+void frame_sched_drop(struct frame_sched* fs, enum sched_consumer c, enum sched_drop_reason reason) {
+    record_drop(fs, c, reason, 0);
+}
+
+/*
+* 限速模式下休眠到下一个节拍
+* 使用clock_nanosleep(TIMER_ABSTIME)，节拍在绝对时间轴上累加，不会因每帧处理时间而漂移
+*/
+void frame_sched_wait(struct frame_sched* fs) {
+    if (fs->loop_period_ns == 0) {
+        return;
+    }
+    fs->next_tick_ns += fs->loop_period_ns;
+    int64_t now = monotonic_ns();
+    if (fs->next_tick_ns <= now) {
+        // 已经落后，从当前时间重新对齐
+        fs->next_tick_ns = now;
+        return;
+    }
+    struct timespec ts = {
+        .tv_sec = fs->next_tick_ns / 1000000000LL,
+        .tv_nsec = fs->next_tick_ns % 1000000000LL
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+void frame_sched_report(struct frame_sched* fs) {
+    static const char* reasons[SCHED_DROP_REASON_NUM] = { "超预算", "忙" };
+    printf("[调度] 传感器帧间隔:%.1fms\n", fs->sensor_period_ns / 1e6);
+    for (int i = 0; i < SCHED_CONSUMER_NUM; i++) {
+        struct sched_consumer_state* s = &fs->c[i];
+        if (s->name == NULL) continue;
+        printf("[调度] %s: 目标%dfps 优先级%d 耗时%.1fms 运行%llu 丢弃(%s%llu %s%llu)\n",
+               s->name, s->fps, s->priority, s->cost_ns / 1e6, (unsigned long long)s->runs,
+               reasons[0], (unsigned long long)s->drops[SCHED_DROP_BUDGET],
+               reasons[1], (unsigned long long)s->drops[SCHED_DROP_BUSY]);
+    }
+    // 最近的丢帧记录
+    unsigned int n = fs->log_total < 8 ? fs->log_total : 8;
+    for (unsigned int k = 0; k < n; k++) {
+        unsigned int idx = (fs->log_head + SCHED_DROP_LOG_SIZE - n + k) % SCHED_DROP_LOG_SIZE;
+        struct sched_drop_record* r = &fs->log[idx];
+        printf("[调度]   帧%u %s %s 超出%.1fms\n", r->sequence,
+               fs->c[r->consumer].name, reasons[r->reason], r->over_ns / 1e6);
+    }
+}
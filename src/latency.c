@@ -0,0 +1,126 @@
+#include "latency.h"
+
+static void hist_reset(struct latency_hist* h) {
+    memset(h, 0, sizeof(*h));
+    h->min_ns = INT64_MAX;
+}
+
+// 由直方图估算百分位（ms）
+static int hist_percentile(const struct latency_hist* h, double p) {
+    if (h->count == 0) return 0;
+    uint64_t target = (uint64_t)(h->count * p);
+    uint64_t acc = 0;
+    for (int i = 0; i < LAT_HIST_BUCKETS; i++) {
+        acc += h->bucket[i];
+        if (acc > target) return i;
+    }
+    return LAT_HIST_BUCKETS - 1;
+}
+
+void latency_init(struct latency_stats* ls) {
+    pthread_mutex_init(&ls->lock, NULL);
+    for (int i = 0; i < LAT_STAGE_NUM; i++) {
+        hist_reset(&ls->stage[i]);
+    }
+    ls->have_seq = false;
+    ls->last_seq = 0;
+    ls->frames = 0;
+    ls->dropped = 0;
+}
+
+void latency_destroy(struct latency_stats* ls) {
+    pthread_mutex_destroy(&ls->lock);
+}
+
+void latency_record(struct latency_stats* ls, enum latency_stage stage, const struct frame_meta* meta) {
+    int64_t lat = monotonic_ns() - meta->capture_ns;
+    if (lat < 0) lat = 0;
+    int bucket = lat / 1000000;
+    if (bucket >= LAT_HIST_BUCKETS) bucket = LAT_HIST_BUCKETS - 1;
+
+    pthread_mutex_lock(&ls->lock);
+    struct latency_hist* h = &ls->stage[stage];
+    h->count++;
+    h->sum_ns += lat;
+    if (lat < h->min_ns) h->min_ns = lat;
+    if (lat > h->max_ns) h->max_ns = lat;
+    h->bucket[bucket]++;
+    pthread_mutex_unlock(&ls->lock);
+}
+
+uint32_t latency_track_sequence(struct latency_stats* ls, const struct frame_meta* meta) {
+    uint32_t gap = 0;
+    pthread_mutex_lock(&ls->lock);
+    if (ls->have_seq && meta->sequence > ls->last_seq + 1) {
+        gap = meta->sequence - ls->last_seq - 1;
+        ls->dropped += gap;
+    }
+    ls->have_seq = true;
+    ls->last_seq = meta->sequence;
+    ls->frames++;
+    pthread_mutex_unlock(&ls->lock);
+    return gap;
+}
+
+void latency_reset_sequence(struct latency_stats* ls) {
+    pthread_mutex_lock(&ls->lock);
+    ls->have_seq = false;
+    pthread_mutex_unlock(&ls->lock);
+}
+
+void latency_report(struct latency_stats* ls) {
+    static const char* names[LAT_STAGE_NUM] = { "显示", "编码", "检测" };
+    pthread_mutex_lock(&ls->lock);
+    printf("\n[延迟] 帧数:%llu 传感器丢帧:%llu\n",
+           (unsigned long long)ls->frames, (unsigned long long)ls->dropped);
+    for (int i = 0; i < LAT_STAGE_NUM; i++) {
+        struct latency_hist* h = &ls->stage[i];
+        if (h->count == 0) continue;
+        printf("[延迟] %s: 平均%.1fms 最小%.1fms 最大%.1fms p50=%dms p99=%dms (%llu帧)\n",
+               names[i], h->sum_ns / 1e6 / h->count, h->min_ns / 1e6, h->max_ns / 1e6,
+               hist_percentile(h, 0.5), hist_percentile(h, 0.99), (unsigned long long)h->count);
+        hist_reset(h);
+    }
+    pthread_mutex_unlock(&ls->lock);
+}
+
+void autotune_init(struct buf_autotune* at, unsigned int min_count, unsigned int max_count) {
+    at->done = !at->enabled;
+    at->count = min_count;
+    at->max_count = max_count;
+    if (at->warmup == 0) at->warmup = 30;
+    if (at->window == 0) at->window = 300;
+    at->seen = 0;
+    at->start_dropped = 0;
+}
+
+/*
+* 每帧调用一次
+* 预热期结束后开始计数，一个窗口内无丢帧则确定当前数量；否则加一个缓冲区重新尝试
+* @return: 需要重新初始化摄像头时返回新的缓冲区数量，否则返回0
+*/
+unsigned int autotune_update(struct buf_autotune* at, const struct latency_stats* ls) {
+    if (at->done) return 0;
+    at->seen++;
+    if (at->seen == at->warmup) {
+        at->start_dropped = ls->dropped;
+        return 0;
+    }
+    if (at->seen < at->warmup + at->window) return 0;
+
+    uint64_t dropped = ls->dropped - at->start_dropped;
+    if (dropped == 0) {
+        at->done = true;
+        printf("[自动调节] 缓冲区数量确定为 %u（%u帧内无丢帧）\n", at->count, at->window);
+        return 0;
+    }
+    if (at->count >= at->max_count) {
+        at->done = true;
+        printf("[自动调节] 缓冲区数量已达上限 %u，仍丢帧 %llu\n", at->count, (unsigned long long)dropped);
+        return 0;
+    }
+    printf("[自动调节] 缓冲区数量 %u 时丢帧 %llu，尝试 %u\n", at->count, (unsigned long long)dropped, at->count + 1);
+    at->count++;
+    at->seen = 0;
+    return at->count;
+}
@@ -1,12 +1,61 @@
 //
 #include "../include/common.h"   
+#include "../include/model_loader.h"  // 模型后台加载与预热
+#include "../include/supervisor.h"    // 故障监控与子系统热重建
+#include "../include/zone.h"          // 检测区域
+#include "../include/dual_capture.h"  // 双码流采集（检测用小分辨率子码流）
+#include "../include/nv12.h"          // 子码流缩小、ePTZ裁剪缩放
+#include "../include/eptz.h"          // 电子云台（跟随行人裁剪放大）
+#include "../include/trace.h"         // 阶段耗时追踪（Chrome trace）
+#include "../include/profiler.h"      // 进程内采样分析（perf_event_open）
 
 
-#define CAM_DEV     "/dev/video1"  // 摄像头设备路径
-#define OUTPUT_FILE "./video/output.mp4"  // 视频输出文件名
-#define FPS 10        // 设置帧率
+#define CAM_DEV     "/dev/video1"  // 摄像头设备路径（普通文件时按NV12原始帧循环读取，用于测试）
+#define DET_DEV     NULL           // 检测用子码流设备（如ISP第二路输出），NULL表示检测与显示录像共用主码流
+#define OUTPUT_DIR  "./video"  // 分段录像目录（rec_YYYYmmdd_HHMMSS.mp4）
+#define SEGMENT_SECONDS  300                       // 每个分段的时长
+#define SEGMENT_PREALLOC (16ULL * 1024 * 1024)     // 每个分段预分配空间
+#define DISK_BUDGET      (2ULL * 1024 * 1024 * 1024) // 录像目录占用上限，超出时删除最旧的分段
+#define INDEX_INTERVAL_MS 1000                    // 事件索引的检测汇总周期
+#define FPS 10        // 录像帧率（编码器时间基准）
+#define DISPLAY_FPS 0       // 显示帧率，0表示跟随传感器
+#define RECORD_FPS  FPS     // 录像帧率
+#define DETECT_FPS  0       // 检测提交帧率，0表示检测线程空闲即提交
 #define camera_width  800
 #define camera_height 480
+#define det_width   320     // 子码流分辨率（接近模型输入，宽高比与主码流相同）
+#define det_height  192
+#define DET_BUFFERS 3       // 子码流缓冲区数量
+#define PAIR_SKEW_MS 10     // 子码流帧与主码流帧配对允许的时间差
+#define FILE_FPS    30      // 文件源帧率
+#define CAM_BUFFERS     4   // 默认采集缓冲区数量（缓冲区数量过多会导致画面延迟）
+#define CAM_BUFFERS_MIN 3   // 自动调节的起点（v4l2_init要求至少3个）
+#define CAM_BUFFERS_MAX 8   // 自动调节的上限
+#define LATENCY_REPORT_NS 5000000000LL  // 延迟统计打印周期
+#define DET_INFLIGHT 2      // 检测流水线在途帧数（预处理与推理重叠）
+#define FRAME_POOL_COUNT (2 + DET_INFLIGHT)  // 帧池帧数：检测在途 + 余量
+#define STREAM_PORT 8080    // 实时流端口（HTTP H.264裸流），0表示不启用
+#define SUB_STREAM_PORT 8081   // 子码流实时流端口（低分辨率低码率，远程观看），0表示不启用
+#define sub_width  400         // 子码流分辨率（正好是主码流一半时走2x2快速缩小）
+#define sub_height 240
+#define SUB_FPS       FPS      // 子码流帧率
+#define SUB_BIT_RATE  150000   // 子码流码率
+#define SUB_MAX_RATE  500000
+#define SUB_GOP       (FPS * 2)   // 子码流关键帧间隔（帧），远程观看时新连接等待关键帧的时间更短
+#define SHM_NAME     "/k230_pipeline"  // 共享内存发布名（/dev/shm/k230_pipeline）
+#define SHM_FRAME_SLOTS 4   // 共享内存帧槽数（读者落后超过槽数时跳帧）
+#define SHM_DET_SLOTS   8
+#define PUBLISH_FPS  0      // 共享内存发布帧率，0表示跟随传感器
+#define STALL_TIMEOUT_MS  1000  // 超过该时间没有新帧视为采集卡死，重建摄像头
+#define COMMIT_FAIL_LIMIT 3     // 连续显示提交失败次数达到该值时重建显示
+#define MAX_RESTARTS      5     // 每个子系统每分钟最多重建次数，超出后退出程序
+#define ZONES_FILE "./zones.conf"  // 检测区域配置，文件不存在时不按区域过滤
+#define EPTZ_MAX_ZOOM  3.0f     // ePTZ最大放大倍数
+#define EPTZ_MARGIN    0.25f    // 取景时检测框外扩比例
+#define EPTZ_SMOOTH_MS 400      // 取景框移动的平滑时间常数
+#define EPTZ_HOLD_MS   2000     // 人消失后保持取景的时间，之后回到全景
+#define EPTZ_DEADBAND  16       // 目标变化小于该像素数时不跟随
+#define ZONE_CELL  4               // 区域位图的栅格大小（像素）
 
 
 
@@ -17,133 +66,373 @@ long get_elapsed_ns(struct timespec *start, struct timespec *end) {
            (end->tv_nsec - start->tv_nsec);
 }
 
-// 检测线程的数据---------------------------------------------------------
+// 缩小后的共享帧：每个主码流帧最多缩小一次，子码流编码和检测（没有子码流设备时）共用
 typedef struct {
-    pthread_mutex_t mutex;             // 互斥锁
-    pthread_cond_t cond;               // 条件变量
-    bool isready;                      // 就绪标志 // 有帧在处理时为false，无时为true
-    bool exit_flag;
-    struct mydisplay* det_disp;        // 显示设备
-    uint8_t* frame_copy;               // 待检测数据
-    int frame_width;
-    int frame_height;    
-} ThreadData;
-
-// 检测线程函数
-void* detection_thread(void* arg) {
-    ThreadData* data = (ThreadData*)arg;
-    struct timespec det_start, det_end; // 用于计时的结构体
-    while (1) {
-        
-        pthread_mutex_lock(&data->mutex);  // 上锁
-        // 退出检查
-        if( data->exit_flag){
-            pthread_mutex_unlock(&data->mutex);
-            break;
-        }
+    uint8_t* data;     // NV12，width*height*3/2
+    int width, height;
+    struct frame_desc frame;  // 缩小结果的帧描述（紧凑排列，元数据取自原帧）
+    bool valid;        // 已经是当前帧的缩小结果
+} ScaledFrame;
 
-        // 等待任务唤醒
-        while (data->isready && !data->exit_flag ) {
-            pthread_cond_wait(&data->cond, &data->mutex);  // pthread_cond_wait会自动释放锁，并在返回前重新获取锁
-        }
+static const struct frame_desc* scaled_frame_get(ScaledFrame* sf, const struct frame_desc* src) {
+    if (!sf->valid) {
+        sf->frame = frame_desc_nv12_packed(sf->data, sf->width, sf->height);
+        sf->frame.meta = src->meta;
+        nv12_scale(src, &sf->frame);
+        sf->valid = true;
+    }
+    return &sf->frame;
+}
 
-        // 二次检查：唤醒后立即检查退出标志
-        if (data->exit_flag) {
-            pthread_mutex_unlock(&data->mutex);
-            break;
-        }
-        pthread_mutex_unlock(&data->mutex); 
-        
-        // 执行检测
-        clock_gettime(CLOCK_MONOTONIC, &det_start);
-        struct all_det_location * all_location = detectframe(data->frame_copy, data->frame_width, data->frame_height);
-        if( all_location != NULL) {
-            //fprintf(stderr, "检测到 %d 个行人\n", num);
-            draw_box(data->det_disp, all_location); // 绘制检测到的行人方框
-        }
-        else{
-            clear_box(data->det_disp); // 清除方框显示
+// 检测结果的接收方---------------------------------------------------------
+typedef struct {
+    struct mydisplay* det_disp;        // 显示设备
+    struct latency_stats* latency;     // 延迟统计
+    VideoEncoder* enc;                 // 编码器（接收检测结果做码率控制）
+    struct shm_ring* shm;              // 共享内存发布（未启用时header为NULL）
+    float box_sx, box_sy;              // 检测坐标到主码流坐标的缩放（检测用子码流时不为1）
+    struct supervisor* sv;             // 重建显示/编码器期间不能访问它们
+    struct eptz* eptz;                 // ePTZ模式下框由主线程按取景框映射后绘制（未启用时为NULL）
+    int64_t last_result_ns;            // 上一个结果的时间（统计检测帧率）
+} DetContext;
+
+// 检测结果回调（在检测流水线的后处理线程中调用）
+static void on_detection(struct det_result* result, void* arg) {
+    DetContext* ctx = (DetContext*)arg;
+    struct pool_frame* frame = (struct pool_frame*)result->user;
+    if (result->locations != NULL && (ctx->box_sx != 1.0f || ctx->box_sy != 1.0f)) {
+        for (int i = 0; i < result->locations->count; i++) {
+            struct det_location* l = result->locations->locations[i];
+            l->x1 = (int)(l->x1 * ctx->box_sx);
+            l->y1 = (int)(l->y1 * ctx->box_sy);
+            l->x2 = (int)(l->x2 * ctx->box_sx);
+            l->y2 = (int)(l->y2 * ctx->box_sy);
         }
+    }
+    shm_ring_publish_detections(ctx->shm, result->locations, frame->meta.sequence, frame->meta.capture_ns);
+    pthread_mutex_lock(&ctx->sv->lock);
+    video_encoder_update_detections(ctx->enc, result->locations);  // 绘制会释放结果，先交给编码器
+    if (ctx->eptz) {
+        eptz_update_detections(ctx->eptz, result->locations);
+        free_det_location(result->locations);
+    }
+    else if (result->locations != NULL) {
+        draw_box(ctx->det_disp, result->locations); // 绘制检测到的行人方框
+    }
+    else {
+        clear_box(ctx->det_disp); // 清除方框显示
+    }
+    pthread_mutex_unlock(&ctx->sv->lock);
+    latency_record(ctx->latency, LAT_DETECT, &frame->meta);
+    pool_frame_put(frame);
 
-        // 任务结束，标记线程可接受新任务
-        pthread_mutex_lock(&data->mutex);
-        data->isready = true;
-        pthread_mutex_unlock(&data->mutex); 
-        clock_gettime(CLOCK_MONOTONIC, &det_end);      
-        printf("识别平均帧率：%.3f\n", 1e9 / get_elapsed_ns(&det_start,&det_end));
+    int64_t now = monotonic_ns();
+    if (ctx->last_result_ns) {
+        printf("识别平均帧率：%.3f (预处理%.1fms 推理%.1fms 后处理%.1fms)\n", 1e9 / (now - ctx->last_result_ns),
+               result->stage_ns[DET_STAGE_PRE] / 1e6, result->stage_ns[DET_STAGE_KPU] / 1e6,
+               result->stage_ns[DET_STAGE_POST] / 1e6);
     }
+    ctx->last_result_ns = now;
+}
+
+
+
+// 摄像头初始化任务（与显示初始化并行执行）
+typedef struct {
+    struct v4l2_capture* cam;
+    const char* dev;
+    unsigned int buffer_count;
+    int ret;
+    int64_t elapsed_ns;
+} CamInitTask;
+
+static void* cam_init_thread(void* arg) {
+    CamInitTask* task = (CamInitTask*)arg;
+    thread_policy_apply(ROLE_LOADER);
+    int64_t t0 = monotonic_ns();
+    task->ret = v4l2_init(task->cam, task->dev, camera_width, camera_height, task->buffer_count);
+    task->elapsed_ns = monotonic_ns() - t0;
+    thread_policy_exit();
     return NULL;
 }
 
+// 启动各阶段耗时
+typedef struct {
+    int64_t t0;             // main()开始时间
+    int64_t display_ns;     // 显示初始化
+    int64_t camera_ns;      // 摄像头初始化（并行）
+    int64_t encoder_ns;     // 编码器初始化
+    int64_t first_frame_ns; // 启动到首帧提交显示
+} StartupTiming;
+
+static void print_startup_timing(const StartupTiming* st) {
+    printf("启动耗时: 显示%.1fms 摄像头%.1fms(并行) 编码器%.1fms 首帧%.1fms\n",
+           st->display_ns / 1e6, st->camera_ns / 1e6,
+           st->encoder_ns / 1e6, st->first_frame_ns / 1e6);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "用法: %s [-a] [-e] [-f fps] [-p file] [-s port] [-S port] [-t file] [-z zones] [-c dev] [-d dev]\n", prog);
+    fprintf(stderr, "  -a      自动调节采集缓冲区数量（取实际负载下不丢帧的最小值）\n");
+    fprintf(stderr, "  -e      ePTZ：显示画面跟随检测到的行人裁剪放大（最大%.1f倍）\n", EPTZ_MAX_ZOOM);
+    fprintf(stderr, "  -f fps  主循环限速帧率（默认跟随传感器帧率）\n");
+    fprintf(stderr, "  -p file 性能分析：采样各线程热点函数、统计各阶段周期/指令/缓存缺失，退出时写出报告\n");
+    fprintf(stderr, "  -s port 实时流端口（默认%d，0表示不启用）\n", STREAM_PORT);
+    fprintf(stderr, "  -S port 子码流实时流端口（默认%d，%dx%d，0表示不启用）\n", SUB_STREAM_PORT, sub_width, sub_height);
+    fprintf(stderr, "  -t file 阶段耗时追踪输出（Chrome trace JSON），运行中kill -USR2切换记录开关\n");
+    fprintf(stderr, "  -z file 检测区域配置（默认%s）\n", ZONES_FILE);
+    fprintf(stderr, "  -c dev  主码流设备（默认%s，普通文件按%dx%d NV12帧读取）\n", CAM_DEV, camera_width, camera_height);
+    fprintf(stderr, "  -d dev  检测用子码流设备（%dx%d），不指定时检测使用主码流\n", det_width, det_height);
+}
 
+// 编码包回调：转发给实时流服务
+static void stream_on_packet(void* opaque, const AVPacket* pkt) {
+    stream_server_publish((struct stream_server*)opaque, pkt);
+}
 
-int main() {
+int main(int argc, char* argv[]) {
+    struct buf_autotune autotune = { .enabled = false };
+    int loop_fps = 0;
+    int stream_port = STREAM_PORT;
+    int sub_stream_port = SUB_STREAM_PORT;
+    bool eptz_on = false;
+    const char* zones_path = ZONES_FILE;
+    const char* cam_dev = CAM_DEV;
+    const char* det_dev = DET_DEV;
+    const char* trace_path = NULL;
+    const char* prof_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "aef:p:s:S:t:z:c:d:h")) != -1) {
+        switch (opt) {
+            case 'a': autotune.enabled = true; break;
+            case 'e': eptz_on = true; break;
+            case 'f': loop_fps = atoi(optarg); break;
+            case 'p': prof_path = optarg; break;
+            case 's': stream_port = atoi(optarg); break;
+            case 'S': sub_stream_port = atoi(optarg); break;
+            case 't': trace_path = optarg; break;
+            case 'z': zones_path = optarg; break;
+            case 'c': cam_dev = optarg; break;
+            case 'd': det_dev = optarg; break;
+            default: usage(argv[0]); return EXIT_FAILURE;
+        }
+    }
+    autotune_init(&autotune, CAM_BUFFERS_MIN, CAM_BUFFERS_MAX);
+    // 采样事件继承到之后创建的线程，必须在创建任何线程之前启动
+    if (prof_path && profiler_start(prof_path, NULL) != 0) {
+        return EXIT_FAILURE;
+    }
+    if (trace_path) {
+        if (trace_start(trace_path, true) != 0) {
+            return EXIT_FAILURE;
+        }
+        trace_toggle_on_signal(SIGUSR2);
+    }
+    // 主线程负责采集与显示；之后创建的线程各自在入口处切换到自己的策略，编码库的内部线程在video_encoder_init中按普通调度创建
+    thread_policy_apply(ROLE_CAPTURE);
 
     struct timespec start, end; // 用于局部计时的结构体
     struct timespec tstart, tend; // 用于局部计时的结构体
-    const long target_frame_ns = (long)(1.0 / FPS * 1e9);
+    StartupTiming startup = { .t0 = monotonic_ns() };
+    int64_t t_phase;
+
+    // 摄像头初始化与显示初始化同时进行
+    struct v4l2_capture cam = { .fd = -1, .file_fps = FILE_FPS };
+    CamInitTask cam_task = {
+        .cam = &cam, .dev = cam_dev, .ret = -1,
+        .buffer_count = autotune.enabled ? autotune.count : CAM_BUFFERS
+    };
+    pthread_t cam_thread;
+    if (pthread_create(&cam_thread, NULL, cam_init_thread, &cam_task)) {
+        fprintf(stderr, "无法创建摄像头初始化线程\n");
+        return EXIT_FAILURE;
+    }
+
+    // 帧池：各阶段的NV12帧都从这里借还，内存占用固定
+    struct frame_pool pool;
+    if (frame_pool_init(&pool, "nv12_frame", camera_width * camera_height * 3 / 2, FRAME_POOL_COUNT) != 0) {
+        fprintf(stderr, "帧池初始化失败\n");
+        pthread_join(cam_thread, NULL);
+        v4l2_destroy(&cam);
+        return EXIT_FAILURE;
+    }
+
+    // 子码流缩小帧（启用子码流时分配）；没有子码流设备时检测也使用它，拷贝和ai2d的数据量更小
+    ScaledFrame scaled = { .width = sub_width, .height = sub_height };
+    if (sub_stream_port > 0) {
+        scaled.data = malloc(sub_width * sub_height * 3 / 2);
+        if (!scaled.data) {
+            fprintf(stderr, "子码流缓冲区分配失败，不启用子码流\n");
+            sub_stream_port = 0;
+        }
+    }
+    bool det_scaled = !det_dev && scaled.data;
 
     // // 初始化显示
+    t_phase = monotonic_ns();
     struct mydisplay mydisp = { .width = 800, .height = 480, .disp_buf_index = 0 };
     if (drm_nv12_init(&mydisp) != 0) {
         fprintf(stderr, "显示初始化失败\n");
+        pthread_join(cam_thread, NULL);
+        v4l2_destroy(&cam);
+        free(scaled.data);
+        frame_pool_destroy(&pool);
         return EXIT_FAILURE;
     }
+    startup.display_ns = monotonic_ns() - t_phase;
 
-    // 初始化行人检测模型
-    if (!init_person_detector(
-        "./model/person_detect_yolov5n.kmodel", 
-        0.5, 0.3, 0)) {
-        fprintf(stderr, "行人检测模型初始化失败\n");
-        return EXIT_FAILURE;
+    // 后台加载行人检测模型（必须在显示初始化之后），加载完成前视频照常显示
+    struct model_loader loader = {
+        .model_path = "./model/person_detect_yolov5n.kmodel",
+        .conf_threshold = 0.5, .nms_threshold = 0.3,
+        .warmup_width = det_dev ? det_width : (det_scaled ? sub_width : camera_width),
+        .warmup_height = det_dev ? det_height : (det_scaled ? sub_height : camera_height)
+    };
+    if (model_loader_start(&loader) != 0) {
+        fprintf(stderr, "模型加载线程启动失败，仅运行视频流\n");
     }
 
-    // 初始化摄像头
-    struct v4l2_capture cam = {0};
-    if ( v4l2_init( &cam, CAM_DEV, camera_width, camera_height, 4)) {
+    // 等待摄像头初始化完成
+    pthread_join(cam_thread, NULL);
+    startup.camera_ns = cam_task.elapsed_ns;
+    if (cam_task.ret) {
         fprintf(stderr, "V4L2初始化失败\n");
+        model_loader_join(&loader);
+        destroy_person_detector();
         mydisplay_destroy(&mydisp);
+        free(scaled.data);
+        frame_pool_destroy(&pool);
         return EXIT_FAILURE;
     }
 
+    // 检测用子码流：打开失败时检测退回主码流
+    struct v4l2_capture det_cam = { .fd = -1, .file_fps = FILE_FPS };
+    struct dual_capture dual = { .sub = NULL };
+    int det_w = det_scaled ? sub_width : camera_width;
+    int det_h = det_scaled ? sub_height : camera_height;
+    if (det_dev) {
+        if (v4l2_init(&det_cam, det_dev, det_width, det_height, DET_BUFFERS) == 0) {
+            dual_capture_init(&dual, &det_cam, PAIR_SKEW_MS);
+            det_w = det_width;
+            det_h = det_height;
+        } else {
+            fprintf(stderr, "子码流初始化失败，检测使用主码流\n");
+        }
+    }
+
     // 初始化视频保存
+    t_phase = monotonic_ns();
     VideoEncoder enc = {
-        .width = camera_width, .height = camera_height,
-        .frame_rate = FPS, .bit_rate = 200000,
-        .max_rate = 4000000, .output_file = OUTPUT_FILE
+        .name = "主码流", .width = camera_width, .height = camera_height,
+        .frame_rate = FPS, .bit_rate = 400000,
+        .max_rate = 4000000,
+        .output_dir = OUTPUT_DIR, .segment_seconds = SEGMENT_SECONDS,
+        .segment_prealloc = SEGMENT_PREALLOC, .disk_budget = DISK_BUDGET,
+        .index_interval_ms = INDEX_INTERVAL_MS,
+        .quiet_bit_rate = 100000, .quiet_frame_div = 2,
+        .active_gop = FPS * 2, .active_hold_ms = 3000,
+        .roi_qoffset = -0.3f
     };
     if (video_encoder_init(&enc) != 0) {
         fprintf(stderr, "编码器初始化失败\n");
+        model_loader_join(&loader);
+        destroy_person_detector();
         mydisplay_destroy(&mydisp);
         v4l2_destroy(&cam);
+        free(scaled.data);
+        frame_pool_destroy(&pool);
         return -1;
     }
+    startup.encoder_ns = monotonic_ns() - t_phase;
 
+    // 实时流：直接转发编码器输出，启动失败不影响录像
+    struct stream_server stream = {0};
+    if (stream_port > 0 && stream_server_start(&stream, stream_port) == 0) {
+        stream_server_set_extradata(&stream, enc.codec_ctx->extradata, enc.codec_ctx->extradata_size);
+        enc.on_packet = stream_on_packet;
+        enc.on_packet_opaque = &stream;
+    }
 
-    // 初始化线程数据
-    ThreadData thread_data = {
-        .isready = true,
-        .exit_flag = false,
-        .det_disp = &mydisp,
-        .frame_copy = malloc(camera_width * camera_height * 3 / 2), //NV12
-        .frame_width = camera_width,
-        .frame_height = camera_height
+    // 子码流：同一采集帧缩小后单独编码（独立的码率和关键帧间隔），只输出到子码流实时流，不写文件
+    struct stream_server sub_stream = {0};
+    VideoEncoder sub_enc = {
+        .name = "子码流", .width = sub_width, .height = sub_height,
+        .frame_rate = SUB_FPS, .bit_rate = SUB_BIT_RATE, .max_rate = SUB_MAX_RATE,
+        .gop = SUB_GOP,
+        .on_packet = stream_on_packet, .on_packet_opaque = &sub_stream
     };
-    if (!thread_data.frame_copy) {
-        fprintf(stderr, "帧缓冲区分配失败\n");
-        return EXIT_FAILURE;
-    }   
-    pthread_mutex_init(&thread_data.mutex, NULL);  // 初始化互斥锁
-    pthread_cond_init(&thread_data.cond, NULL);  
-
-    // 创建检测线程
-    pthread_t det_thread;
-    if (pthread_create(&det_thread, NULL, detection_thread, &thread_data)) {
-        fprintf(stderr, "无法创建识别线程\n");
-        free(thread_data.frame_copy);
-        return EXIT_FAILURE;
+    if (sub_stream_port > 0 && stream_server_start(&sub_stream, sub_stream_port) == 0) {
+        if (video_encoder_init(&sub_enc) == 0) {
+            stream_server_set_extradata(&sub_stream, sub_enc.codec_ctx->extradata, sub_enc.codec_ctx->extradata_size);
+        } else {
+            fprintf(stderr, "子码流编码器初始化失败，不启用子码流\n");
+            stream_server_stop(&sub_stream);
+        }
     }
 
+
+    // 故障监控：采集卡死、显示提交失败、编码失败时只重建对应子系统，模型和帧池保持不变
+    struct supervisor sv = {
+        .stall_timeout_ms = STALL_TIMEOUT_MS,
+        .commit_fail_limit = COMMIT_FAIL_LIMIT,
+        .max_restarts = MAX_RESTARTS, .restart_window_ms = 60000
+    };
+    supervisor_init(&sv);
+
+    struct latency_stats latency;
+    latency_init(&latency);
+    int64_t last_report_ns = monotonic_ns();
+
+    // 帧调度：各消费者独立帧率，超预算时低优先级先丢帧
+    struct frame_sched sched;
+    frame_sched_init(&sched, loop_fps);
+    frame_sched_set_rate(&sched, SCHED_DISPLAY, "显示", DISPLAY_FPS, 0);
+    frame_sched_set_rate(&sched, SCHED_RECORD, "录像", RECORD_FPS, 1);
+    frame_sched_set_rate(&sched, SCHED_DETECT, "检测", DETECT_FPS, 2);
+    frame_sched_set_rate(&sched, SCHED_PUBLISH, "发布", PUBLISH_FPS, 4);
+    if (sub_enc.initialized) {
+        frame_sched_set_rate(&sched, SCHED_SUBSTREAM, "子码流", SUB_FPS, 3);
+    }
+
+    // 共享内存发布：其他进程直接映射读取帧和检测结果，失败时不影响主流程
+    struct shm_ring shm = {0};
+    shm_ring_create(&shm, SHM_NAME, camera_width, camera_height, SHM_FRAME_SLOTS, SHM_DET_SLOTS);
+
+    // 检测区域：加载时栅格化一次，检测后处理中按区域过滤
+    struct zone_map zones = {0};
+    if (access(zones_path, R_OK) == 0 &&
+        zone_map_load(&zones, zones_path, camera_width, camera_height, ZONE_CELL) != 0) {
+        fprintf(stderr, "区域配置无效，不按区域过滤\n");
+    }
+
+    // ePTZ：检测线程更新目标，显示时裁剪取景框并缩放到屏幕
+    struct eptz ez = {
+        .src_width = camera_width, .src_height = camera_height,
+        .out_width = mydisp.width, .out_height = mydisp.height,
+        .max_zoom = EPTZ_MAX_ZOOM, .margin = EPTZ_MARGIN,
+        .smooth_ms = EPTZ_SMOOTH_MS, .hold_ms = EPTZ_HOLD_MS, .deadband = EPTZ_DEADBAND
+    };
+    if (eptz_on) {
+        eptz_init(&ez);
+    }
+
+    // 检测流水线在模型就绪后启动
+    DetContext det_ctx = {
+        .det_disp = &mydisp,
+        .latency = &latency,
+        .enc = &enc,
+        .shm = &shm,
+        .box_sx = (float)camera_width / det_w,
+        .box_sy = (float)camera_height / det_h,
+        .sv = &sv,
+        .eptz = eptz_on ? &ez : NULL,
+        .last_result_ns = 0
+    };
+    bool det_started = false;
+
+    // 流水线缓冲区都已分配，锁定内存后实时主线程不再因缺页抖动（检测流水线在模型就绪后才分配，不在其中）
+    thread_policy_lock_memory();
+
     // 设置终端为非阻塞模式
     struct termios old_term, new_term;
     tcgetattr(STDIN_FILENO, &old_term);
@@ -152,7 +441,7 @@ int main() {
     tcsetattr(STDIN_FILENO, TCSANOW, &new_term);
     printf("已启动摄像头到显示屏的流媒体\n");
     printf("按回车键退出程序\n");
-    int t =0;
+    bool first_frame = true;
     while (1) {
         clock_gettime(CLOCK_MONOTONIC, &tstart);
         // 1、检查退出键
@@ -174,107 +463,258 @@ int main() {
         //fprintf(stderr, "等待摄像头数据...\n");
         clock_gettime(CLOCK_MONOTONIC, &start);
         struct v4l2_buffer buf;
-        memset(&buf, 0, sizeof(buf));
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
-        if (ioctl(cam.fd, VIDIOC_DQBUF, &buf) < 0) {
-            if (errno == EAGAIN) {
-                usleep(5000);
-                continue;
+        struct frame_meta meta;
+        int64_t tr_frame = trace_begin();
+        int64_t tr = tr_frame;
+        int dq = v4l2_wait(&cam, sv.stall_timeout_ms);
+        if (dq == 0) {
+            dq = v4l2_dequeue(&cam, &buf, &meta);
+        } else if (dq > 0) {
+            fprintf(stderr, "采集卡死：%dms内没有新帧\n", sv.stall_timeout_ms);
+            dq = -1;
+        }
+        if (dq > 0) {
+            usleep(5000);
+            continue;
+        }
+        if (dq < 0) {
+            unsigned int count = autotune.enabled ? autotune.count : CAM_BUFFERS;
+            if (supervisor_restart_camera(&sv, &cam, cam_dev, camera_width, camera_height, count) != 0) {
+                break;
             }
-            perror("出队失败");
-            break;
+            latency_reset_sequence(&latency);
+            continue;
+        }
+        struct frame_desc frame;  // 按驱动给出的行步长和平面偏移访问，不假设紧凑排列
+        v4l2_frame(&cam, &buf, &meta, &frame);
+        trace_end("dqbuf", meta.sequence, tr);
+        scaled.valid = false;
+        uint32_t gap = latency_track_sequence(&latency, &meta);
+        if (gap) {
+            printf("传感器丢帧:%u ", gap);
         }
-        uint8_t *cam_data = (uint8_t*)cam.buffers[buf.index].start;
         clock_gettime(CLOCK_MONOTONIC, &end);
         printf("取帧:%.3fms ", get_elapsed_ns(&start, &end) / 1000000.0 );
 
-        // 5、线程识别
-        clock_gettime(CLOCK_MONOTONIC, &start);
-        pthread_mutex_lock(&thread_data.mutex);  // 互斥锁
-        if (thread_data.isready ) {
-            // 复制帧到识别缓冲区
-            memcpy(thread_data.frame_copy, cam_data, camera_width * camera_height * 3 / 2);
-            thread_data.isready = false; // 标记忙
-            pthread_cond_signal(&thread_data.cond);  // 唤醒检测线程
-        }
-        pthread_mutex_unlock(&thread_data.mutex); // 释放锁
-        clock_gettime(CLOCK_MONOTONIC, &end);
-        printf("线程:%.3fms ", get_elapsed_ns(&start, &end) / 1000000.0 );
+        frame_sched_begin(&sched, &meta);
 
         // 3、LCD显示处理
-        clock_gettime(CLOCK_MONOTONIC, &start);
-        int frame_index = (mydisp.disp_buf_index + 1)%3; // 计算下一个缓冲区索引
-        memcpy(mydisp.disp_buf[frame_index]->map, cam_data, 
-               mydisp.width * mydisp.height * 3 / 2);
-        clock_gettime(CLOCK_MONOTONIC, &end);
-        printf("显示拷贝:%.3fms ", get_elapsed_ns(&start, &end) / 1000000.0 );
-        display_update_buffer(mydisp.disp_buf[frame_index], 0, 0); 
-        clock_gettime(CLOCK_MONOTONIC, &end);
-        printf("显示updatabuffer:%.3fms ", get_elapsed_ns(&start, &end) / 1000000.0 );
-        int ret = display_commit(mydisp.disp);  
-        clock_gettime(CLOCK_MONOTONIC, &end);
-        printf("显示commit:%.3fms ", get_elapsed_ns(&start, &end) / 1000000.0 );
-        if (ret < 0) {
-            fprintf(stderr, "提交显示缓冲区失败: %d\n", ret);
-            break;
-        }
-        else{
-            //fprintf(stderr, "提交显示缓冲区成功，等待垂直同步\n");
-            display_wait_vsync(mydisp.disp);  // 等待垂直同步
-            mydisp.disp_buf_index = frame_index;  // 更新当前显示缓冲区索引
+        if (frame_sched_should_run(&sched, SCHED_DISPLAY)) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            tr = trace_begin();
+            prof_begin("display_copy");
+            int frame_index = (mydisp.disp_buf_index + 1)%3; // 计算下一个缓冲区索引
+            struct frame_desc disp_frame;
+            mydisplay_frame(&mydisp, frame_index, &disp_frame);
+            if (eptz_on) {
+                // 裁剪只调整帧描述的偏移，缩放直接写入显示缓冲区；取景框移动时重画叠加层上的框
+                bool redraw;
+                struct frame_desc view = eptz_step(&ez, &frame, &redraw);
+                if (view.width == disp_frame.width && view.height == disp_frame.height) {
+                    nv12_copy(&disp_frame, &view);  // 取景框与屏幕等大（没有放大）：直接拷贝，不走双线性
+                } else {
+                    nv12_scale(&view, &disp_frame);
+                }
+                if (redraw) {
+                    struct det_location boxes[EPTZ_MAX_BOXES];
+                    draw_boxes(&mydisp, boxes, eptz_map_boxes(&ez, boxes, EPTZ_MAX_BOXES));
+                }
+            } else {
+                nv12_copy(&disp_frame, &frame);  // 行内没有填充时整块拷贝
+            }
+            prof_end();
+            trace_end(eptz_on ? "display_scale" : "display_copy", meta.sequence, tr);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            printf("显示拷贝:%.3fms ", get_elapsed_ns(&start, &end) / 1000000.0 );
+            tr = trace_begin();
+            display_update_buffer(mydisp.disp_buf[frame_index], 0, 0); 
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            printf("显示updatabuffer:%.3fms ", get_elapsed_ns(&start, &end) / 1000000.0 );
+            int ret = display_commit(mydisp.disp);  
+            trace_end("display_commit", meta.sequence, tr);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            printf("显示commit:%.3fms ", get_elapsed_ns(&start, &end) / 1000000.0 );
+            if (ret < 0) {
+                fprintf(stderr, "提交显示缓冲区失败: %d\n", ret);
+                if (supervisor_commit_failed(&sv) && supervisor_restart_display(&sv, &mydisp) != 0) {
+                    break;
+                }
+            }
+            else{
+                supervisor_commit_ok(&sv);
+                //fprintf(stderr, "提交显示缓冲区成功，等待垂直同步\n");
+                latency_record(&latency, LAT_DISPLAY, &meta);
+                tr = trace_begin();
+                display_wait_vsync(mydisp.disp);  // 等待垂直同步
+                trace_end("vsync_wait", meta.sequence, tr);
+                mydisp.disp_buf_index = frame_index;  // 更新当前显示缓冲区索引
+                if (first_frame) {
+                    first_frame = false;
+                    startup.first_frame_ns = monotonic_ns() - startup.t0;
+                    print_startup_timing(&startup);
+                }
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            frame_sched_done(&sched, SCHED_DISPLAY, get_elapsed_ns(&start, &end));
+            printf("显示:%.3fms ", get_elapsed_ns(&start, &end) / 1000000.0 );
         }
-        clock_gettime(CLOCK_MONOTONIC, &end);
-        printf("显示:%.3fms ", get_elapsed_ns(&start, &end) / 1000000.0 );
-        
 
         // 4、视频编码处理
-        clock_gettime(CLOCK_MONOTONIC, &start);
-        // fprintf(stderr, "处理视频编码...\n");
-        if (video_encoder_process(&enc, cam_data) != 0) {
-            fprintf(stderr, "视频编码处理失败\n");
-            break;
+        if (frame_sched_should_run(&sched, SCHED_RECORD)) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            // fprintf(stderr, "处理视频编码...\n");
+            tr = trace_begin();
+            prof_begin("encode");
+            if (video_encoder_process(&enc, &frame) != 0) {
+                fprintf(stderr, "视频编码处理失败\n");
+                if (supervisor_restart_encoder(&sv, &enc) != 0) {
+                    break;
+                }
+                stream_server_set_extradata(&stream, enc.codec_ctx->extradata, enc.codec_ctx->extradata_size);
+            } else {
+                latency_record(&latency, LAT_ENCODE, &meta);
+            }
+            prof_end();
+            trace_end("encode", meta.sequence, tr);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            frame_sched_done(&sched, SCHED_RECORD, get_elapsed_ns(&start, &end));
+            printf("编码:%.3fms ", get_elapsed_ns(&start, &end) / 1000000.0 );
+        }
+
+        // 4.1、子码流编码（缩小结果与检测共用）
+        if (sub_enc.initialized && frame_sched_should_run(&sched, SCHED_SUBSTREAM)) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            tr = trace_begin();
+            prof_begin("substream");
+            if (video_encoder_process(&sub_enc, scaled_frame_get(&scaled, &frame)) != 0) {
+                // 子码流只是辅助输出：不占用主编码器的重建次数，也不影响录像，直接停用
+                fprintf(stderr, "子码流编码失败，停用子码流\n");
+                video_encoder_release(&sub_enc);   // initialized置0
+                stream_server_stop(&sub_stream);
+            }
+            prof_end();
+            trace_end("substream", meta.sequence, tr);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            frame_sched_done(&sched, SCHED_SUBSTREAM, get_elapsed_ns(&start, &end));
+            printf("子码流:%.3fms ", get_elapsed_ns(&start, &end) / 1000000.0 );
+        }
+
+        // 5、提交检测（模型就绪后启动流水线）
+        if (!det_started && model_loader_ready(&loader)) {
+            set_person_detector_zones(zones.count > 0 ? &zones : NULL);
+            det_started = det_async_start(det_w, det_h, DET_INFLIGHT, on_detection, &det_ctx);
+        }
+        if (det_started && frame_sched_should_run(&sched, SCHED_DETECT)) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            // 有子码流时取时间戳配对的子码流帧，否则取缩小后的共享帧；检测结果按比例映射回主码流
+            tr = trace_begin();
+            prof_begin("det_submit");
+            const struct frame_desc* det_src = &frame;
+            struct frame_desc sub_frame;
+            int paired = dual.sub ? dual_capture_pair(&dual, &meta, &sub_frame) : 0;
+            if (dual.sub && paired == 0) {
+                det_src = &sub_frame;
+            }
+            struct pool_frame* det_frame = (paired == 0 && det_async_ready()) ? frame_pool_get(&pool) : NULL;
+            if (det_frame) {
+                if (det_scaled) {
+                    det_src = scaled_frame_get(&scaled, &frame);
+                }
+                // 按源布局复制到识别缓冲区（紧凑排列），结果返回时在回调中归还
+                struct frame_desc det_desc = frame_desc_nv12_packed(det_frame->virt, det_w, det_h);
+                nv12_copy(&det_desc, det_src);
+                det_desc.meta = meta;
+                det_frame->meta = meta;  // 延迟统计与共享内存发布都以主码流帧为准
+                if (det_async_submit(&det_desc, meta.sequence, meta.capture_ns, det_frame) != 0) {
+                    pool_frame_put(det_frame);
+                    det_frame = NULL;
+                }
+            }
+            if (!det_frame) {
+                frame_sched_drop(&sched, SCHED_DETECT, SCHED_DROP_BUSY);
+            }
+            prof_end();
+            trace_end("det_submit", meta.sequence, tr);
+            if (dual.sub && paired == 0) {
+                paired = dual_capture_release(&dual);
+            }
+            if (paired < 0) {
+                if (supervisor_restart_camera(&sv, &det_cam, det_dev, det_width, det_height, DET_BUFFERS) != 0) {
+                    break;
+                }
+                dual_capture_reset(&dual);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            frame_sched_done(&sched, SCHED_DETECT, get_elapsed_ns(&start, &end));
+            printf("提交识别:%.3fms ", get_elapsed_ns(&start, &end) / 1000000.0 );
         }
-        clock_gettime(CLOCK_MONOTONIC, &end);
-        printf("编码:%.3fms ", get_elapsed_ns(&start, &end) / 1000000.0 );
 
-        // 6、重新入队缓冲区
+        // 6、共享内存发布（优先级最低，超预算时先丢）
+        if (shm.header && frame_sched_should_run(&sched, SCHED_PUBLISH)) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            tr = trace_begin();
+            prof_begin("shm_publish");
+            shm_ring_publish_frame(&shm, &frame);
+            prof_end();
+            trace_end("shm_publish", meta.sequence, tr);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            frame_sched_done(&sched, SCHED_PUBLISH, get_elapsed_ns(&start, &end));
+            printf("发布:%.3fms ", get_elapsed_ns(&start, &end) / 1000000.0 );
+        }
+
+        // 7、重新入队缓冲区
         clock_gettime(CLOCK_MONOTONIC, &start);
-        if (ioctl(cam.fd, VIDIOC_QBUF, &buf) < 0) {
-            perror("入队失败");
-            break;
+        tr = trace_begin();
+        if (v4l2_requeue(&cam, &buf) < 0) {
+            unsigned int count = autotune.enabled ? autotune.count : CAM_BUFFERS;
+            if (supervisor_restart_camera(&sv, &cam, cam_dev, camera_width, camera_height, count) != 0) {
+                break;
+            }
+            latency_reset_sequence(&latency);
         }
+        trace_end("qbuf", meta.sequence, tr);
         clock_gettime(CLOCK_MONOTONIC, &end);
         printf("入队: %.3fms", get_elapsed_ns(&start, &end) / 1000000.0 );
 
+        // 8、缓冲区数量自动调节：丢帧时用更多缓冲区重新开流
+        unsigned int new_count = autotune_update(&autotune, &latency);
+        // 计划内重配置：和故障恢复一样按退避重试，但不占用采集的重建次数
+        if (new_count) {
+            if (supervisor_reconfigure_camera(&sv, &cam, cam_dev, camera_width, camera_height, new_count) != 0) {
+                fprintf(stderr, "V4L2重新初始化失败\n");
+                break;
+            }
+            latency_reset_sequence(&latency);
+        }
+        if (monotonic_ns() - last_report_ns >= LATENCY_REPORT_NS) {
+            latency_report(&latency);
+            frame_sched_report(&sched);
+            thread_policy_report();
+            supervisor_report(&sv);
+            last_report_ns = monotonic_ns();
+        }
+
         clock_gettime(CLOCK_MONOTONIC, &tend); 
         long working_ns = get_elapsed_ns(&tstart, &tend);// 执行部分耗时
         printf("主线程工作耗时:%.3fms ", working_ns / 1000000.0 );
-        long remaining_ns = target_frame_ns - working_ns;
-        if( remaining_ns > 0){
-            printf("进入休眠    ");
-            struct timespec sleep_time = {
-                .tv_sec = remaining_ns / 1000000000L,
-                .tv_nsec = remaining_ns % 1000000000L
-            };
-            nanosleep(&sleep_time, NULL);
-        }
+        trace_end("frame", meta.sequence, tr_frame);
+        tr = trace_begin();
+        frame_sched_wait(&sched);  // 限速模式下按绝对时间轴休眠；默认跟随传感器帧率
+        trace_end("sched_wait", meta.sequence, tr);
         clock_gettime(CLOCK_MONOTONIC, &tend);
         printf("整个流程耗时: %.3f 毫秒，帧率：%.3f \n", get_elapsed_ns(&tstart, &tend) / 1000000.0 , 1e9 / get_elapsed_ns(&tstart, &tend));
     }
     // 清理线程
-    pthread_mutex_lock(&thread_data.mutex);  // 
-    thread_data.exit_flag = true;   // 通知线程退出
-    thread_data.isready = false;
-    pthread_cond_signal(&thread_data.cond); // 
-    pthread_mutex_unlock(&thread_data.mutex); //
-    pthread_join(det_thread, NULL);
-    pthread_mutex_destroy(&thread_data.mutex);
-    pthread_cond_destroy(&thread_data.cond); 
-    free( thread_data.frame_copy);
-
+    det_async_stop();  // 处理完在途帧，回调归还帧池中的帧
+    trace_stop();      // 检测线程已退出，写出剩余事件
+    profiler_stop();
 
+    model_loader_join(&loader);  // 加载未完成时等待其结束再销毁
     destroy_person_detector(); // 销毁识别资源
+    zone_map_free(&zones);
+    if (eptz_on) {
+        eptz_destroy(&ez);
+    }
  
     // 恢复终端设置
     tcsetattr(STDIN_FILENO, TCSANOW, &old_term);
@@ -282,7 +722,25 @@ int main() {
     // 释放资源
     mydisplay_destroy(&mydisp);
     v4l2_destroy(&cam);
+    if (dual.sub) {
+        dual_capture_report(&dual);
+    }
+    v4l2_destroy(&det_cam);
     video_encoder_release(&enc);
+    stream_server_stop(&stream);  // 编码器冲刷时还会回调，放在其后
+    if (sub_enc.initialized) {
+        video_encoder_release(&sub_enc);
+    }
+    stream_server_stop(&sub_stream);
+    free(scaled.data);
+    shm_ring_destroy(&shm);
+    frame_pool_destroy(&pool);
+    latency_report(&latency);
+    latency_destroy(&latency);
+    frame_sched_report(&sched);
+    thread_policy_report();
+    supervisor_report(&sv);
+    supervisor_destroy(&sv);
    
     
     printf("资源已释放,程序已退出\n");
@@ -0,0 +1,230 @@
+#include "nv12.h"
+
+// BT.601视频范围的定点系数（Q20），与OpenCV的YUV420sp->RGB实现相同
+#define YUV_SHIFT 20
+#define YUV_CY    1220542   // 1.164 * (1 << 20)
+#define YUV_CUB   2116026   // 2.018
+#define YUV_CUG   -409993   // -0.391
+#define YUV_CVG   -852492   // -0.813
+#define YUV_CVR   1673527   // 1.596
+#define YUV_HALF  (1 << (YUV_SHIFT - 1))
+
+static inline uint8_t clamp_u8(int v) {
+    return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+/*
+* NV12 -> 平面BGR
+* 每次处理两行两列（共用一组UV），直接写入三个平面，不经过BGR交织的中间图像，
+* 省掉原先cvtColor之后再做HWC->CHW重排的一次整帧拷贝
+*/
+void nv12_to_bgr_chw(const struct frame_desc* img, uint8_t* chw) {
+    const int w = img->width, h = img->height;
+    const size_t plane = (size_t)w * h;
+    uint8_t* restrict b_plane = chw;
+    uint8_t* restrict g_plane = chw + plane;
+    uint8_t* restrict r_plane = chw + plane * 2;
+
+    for (int j = 0; j < h; j += 2) {
+        const uint8_t* restrict y0 = frame_plane(img, 0) + (size_t)j * img->stride[0];
+        const uint8_t* restrict y1 = y0 + img->stride[0];
+        const uint8_t* restrict uv = frame_plane(img, 1) + (size_t)(j / 2) * img->stride[1];
+        size_t o0 = (size_t)j * w;
+        size_t o1 = o0 + w;
+        for (int i = 0; i < w; i += 2) {
+            int u = (int)uv[i] - 128;
+            int v = (int)uv[i + 1] - 128;
+            int ruv = YUV_HALF + YUV_CVR * v;
+            int guv = YUV_HALF + YUV_CVG * v + YUV_CUG * u;
+            int buv = YUV_HALF + YUV_CUB * u;
+
+            int y00 = ((int)y0[i] > 16 ? (int)y0[i] - 16 : 0) * YUV_CY;
+            int y01 = ((int)y0[i + 1] > 16 ? (int)y0[i + 1] - 16 : 0) * YUV_CY;
+            int y10 = ((int)y1[i] > 16 ? (int)y1[i] - 16 : 0) * YUV_CY;
+            int y11 = ((int)y1[i + 1] > 16 ? (int)y1[i + 1] - 16 : 0) * YUV_CY;
+
+            b_plane[o0 + i]     = clamp_u8((y00 + buv) >> YUV_SHIFT);
+            g_plane[o0 + i]     = clamp_u8((y00 + guv) >> YUV_SHIFT);
+            r_plane[o0 + i]     = clamp_u8((y00 + ruv) >> YUV_SHIFT);
+            b_plane[o0 + i + 1] = clamp_u8((y01 + buv) >> YUV_SHIFT);
+            g_plane[o0 + i + 1] = clamp_u8((y01 + guv) >> YUV_SHIFT);
+            r_plane[o0 + i + 1] = clamp_u8((y01 + ruv) >> YUV_SHIFT);
+            b_plane[o1 + i]     = clamp_u8((y10 + buv) >> YUV_SHIFT);
+            g_plane[o1 + i]     = clamp_u8((y10 + guv) >> YUV_SHIFT);
+            r_plane[o1 + i]     = clamp_u8((y10 + ruv) >> YUV_SHIFT);
+            b_plane[o1 + i + 1] = clamp_u8((y11 + buv) >> YUV_SHIFT);
+            g_plane[o1 + i + 1] = clamp_u8((y11 + guv) >> YUV_SHIFT);
+            r_plane[o1 + i + 1] = clamp_u8((y11 + ruv) >> YUV_SHIFT);
+        }
+    }
+}
+
+// 从任意地址读/写8字节（编译为单条访存指令，不要求对齐）
+static inline uint64_t load_u64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void store_u32(uint8_t* p, uint32_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+#define LANE_BYTES  0x00ff00ff00ff00ffULL   // 每个16位通道的低字节
+#define LANE_ROUND  0x0002000200020002ULL   // 4个数求平均的舍入
+#define PAIR_BYTES  0x000000ff000000ffULL   // 每个32位通道的低字节
+
+/*
+* 2x2取平均：一次读两行各8字节，在64位寄存器内按16位通道相加（4个字节之和最大1020，不会进位到相邻通道），
+* 输出4字节。rv64imafdc没有向量扩展，用通用寄存器做SIMD，每8个像素只需要几条整数指令
+* Y：相邻两个字节为一对；UV：U、V交织，相邻的两个U（V）隔一个字节
+*/
+static inline uint32_t box_y8(uint64_t a, uint64_t b) {
+    uint64_t s = (a & LANE_BYTES) + ((a >> 8) & LANE_BYTES) +
+                 (b & LANE_BYTES) + ((b >> 8) & LANE_BYTES) + LANE_ROUND;
+    s = (s >> 2) & LANE_BYTES;
+    s |= s >> 8;   // 四个结果收拢到字节0、1、4、5
+    return (uint32_t)((s & 0xffff) | ((s >> 16) & 0xffff0000));
+}
+
+static inline uint32_t box_uv8(uint64_t a, uint64_t b) {
+    uint64_t ae = a & LANE_BYTES, ao = (a >> 8) & LANE_BYTES;
+    uint64_t be = b & LANE_BYTES, bo = (b >> 8) & LANE_BYTES;
+    uint64_t su = ((ae + (ae >> 16) + be + (be >> 16) + LANE_ROUND) >> 2) & PAIR_BYTES;
+    uint64_t sv = ((ao + (ao >> 16) + bo + (bo >> 16) + LANE_ROUND) >> 2) & PAIR_BYTES;
+    uint64_t s = su | (sv << 8);   // U01 V01 在字节0、1，U23 V23 在字节4、5
+    return (uint32_t)((s & 0xffff) | ((s >> 16) & 0xffff0000));
+}
+
+// 一行2x2取平均：Y平面step=1，UV平面step=2（按U、V分别平均）
+static void box_row(const uint8_t* restrict r0, const uint8_t* restrict r1, uint8_t* restrict out,
+                    int out_bytes, int step) {
+    int i = 0;
+    if (step == 1) {
+        for (; i + 4 <= out_bytes; i += 4) {
+            store_u32(out + i, box_y8(load_u64(r0 + i * 2), load_u64(r1 + i * 2)));
+        }
+        for (; i < out_bytes; i++) {
+            out[i] = (uint8_t)((r0[i * 2] + r0[i * 2 + 1] + r1[i * 2] + r1[i * 2 + 1] + 2) >> 2);
+        }
+    } else {
+        for (; i + 4 <= out_bytes; i += 4) {
+            store_u32(out + i, box_uv8(load_u64(r0 + i * 2), load_u64(r1 + i * 2)));
+        }
+        for (; i < out_bytes; i++) {
+            int k = (i & ~1) * 2 + (i & 1);
+            out[i] = (uint8_t)((r0[k] + r0[k + 2] + r1[k] + r1[k + 2] + 2) >> 2);
+        }
+    }
+}
+
+/*
+* 一个平面的双线性缩放（缩小、放大都可以），分两步：
+* 1. 水平：按预先算好的列表（源字节位置、8位权重）插值出需要的源行，结果缓存，相邻输出行共用同一对源行时不重复计算
+* 2. 垂直：两行缓存按行权重混合
+* 每个输出字节只有两次乘法，放大时源行的水平插值只做一次
+* @step: 1 Y平面，2 UV平面（U、V各自插值）
+*/
+static void bilinear_plane(const uint8_t* src, int sw, int sh, int stride,
+                           uint8_t* dst, int dw, int dh, int dst_stride, int step) {
+    uint16_t x0[NV12_SCALE_MAX_WIDTH], x1[NV12_SCALE_MAX_WIDTH];
+    uint8_t wx[NV12_SCALE_MAX_WIDTH];
+    uint16_t buf_a[NV12_SCALE_MAX_WIDTH], buf_b[NV12_SCALE_MAX_WIDTH];
+    const int n = dw * step;
+    uint32_t sx = ((uint32_t)sw << 16) / dw, sy = ((uint32_t)sh << 16) / dh;
+    for (int i = 0; i < dw; i++) {
+        int32_t fx = (int32_t)(i * sx + (sx >> 1)) - (1 << 15);   // 像素中心对齐
+        if (fx < 0) fx = 0;
+        int a = fx >> 16, b = a + 1 < sw ? a + 1 : sw - 1;
+        for (int c = 0; c < step; c++) {
+            x0[i * step + c] = a * step + c;
+            x1[i * step + c] = b * step + c;
+            wx[i * step + c] = (fx >> 8) & 0xff;
+        }
+    }
+
+    uint16_t* row0 = buf_a;
+    uint16_t* row1 = buf_b;
+    int cached0 = -1, cached1 = -1;   // row0/row1当前缓存的源行
+    for (int j = 0; j < dh; j++) {
+        int32_t fy = (int32_t)(j * sy + (sy >> 1)) - (1 << 15);
+        if (fy < 0) fy = 0;
+        int y0 = fy >> 16, wy = (fy >> 8) & 0xff;
+        int y1 = y0 + 1 < sh ? y0 + 1 : sh - 1;
+        if (y0 == cached1) {   // 向下移动了一行：上一次的下行变成这一次的上行
+            uint16_t* t = row0;
+            row0 = row1;
+            row1 = t;
+            cached0 = y0;
+            cached1 = -1;
+        }
+        const int need[2] = { y0, y1 };
+        uint16_t* rows[2] = { row0, row1 };
+        int* cached[2] = { &cached0, &cached1 };
+        for (int r = 0; r < 2; r++) {
+            if (*cached[r] == need[r]) continue;
+            const uint8_t* s = src + (size_t)need[r] * stride;
+            uint16_t* out = rows[r];
+            for (int k = 0; k < n; k++) {
+                out[k] = (uint16_t)(s[x0[k]] * (256 - wx[k]) + s[x1[k]] * wx[k]);
+            }
+            *cached[r] = need[r];
+        }
+        uint8_t* out = dst + (size_t)j * dst_stride;
+        const uint32_t w0 = 256 - wy, w1 = wy;
+        for (int k = 0; k < n; k++) {
+            out[k] = (uint8_t)((row0[k] * w0 + row1[k] * w1 + (1 << 15)) >> 16);
+        }
+    }
+}
+
+int nv12_scale(const struct frame_desc* src, const struct frame_desc* dst) {
+    const int dw = dst->width, dh = dst->height;
+    if (dw <= 0 || dh <= 0 || (dw | dh) & 1 || dw > NV12_SCALE_MAX_WIDTH ||
+        src->width < 2 || src->height < 2) {
+        return -1;
+    }
+    const uint8_t* src_y = frame_plane(src, 0);
+    const uint8_t* src_uv = frame_plane(src, 1);
+    uint8_t* dst_y = frame_plane(dst, 0);
+    uint8_t* dst_uv = frame_plane(dst, 1);
+    if (src->width == dw * 2 && src->height == dh * 2) {
+        for (int j = 0; j < dh; j++) {
+            const uint8_t* r0 = src_y + (size_t)j * 2 * src->stride[0];
+            box_row(r0, r0 + src->stride[0], dst_y + (size_t)j * dst->stride[0], dw, 1);
+        }
+        for (int j = 0; j < dh / 2; j++) {
+            const uint8_t* r0 = src_uv + (size_t)j * 2 * src->stride[1];
+            box_row(r0, r0 + src->stride[1], dst_uv + (size_t)j * dst->stride[1], dw, 2);
+        }
+        return 0;
+    }
+    bilinear_plane(src_y, src->width, src->height, src->stride[0], dst_y, dw, dh, dst->stride[0], 1);
+    bilinear_plane(src_uv, src->width / 2, src->height / 2, src->stride[1],
+                   dst_uv, dw / 2, dh / 2, dst->stride[1], 2);
+    return 0;
+}
+
+int nv12_copy(const struct frame_desc* dst, const struct frame_desc* src) {
+    if (dst->width != src->width || dst->height != src->height || dst->fourcc != src->fourcc) {
+        return -1;
+    }
+    if (frame_desc_is_packed(dst) && frame_desc_is_packed(src)) {
+        memcpy(dst->base, src->base, (size_t)src->width * src->height * 3 / 2);
+        return 0;
+    }
+    for (int p = 0; p < 2; p++) {
+        int rows = p == 0 ? src->height : src->height / 2;
+        const uint8_t* s = frame_plane(src, p);
+        uint8_t* d = frame_plane(dst, p);
+        // 行内没有填充时整个平面一次拷贝；有填充时逐行拷贝，不写行尾到行步长之间的字节（裁剪区域右侧是别的像素）
+        if (src->stride[p] == src->width && dst->stride[p] == dst->width) {
+            memcpy(d, s, (size_t)src->width * rows);
+            continue;
+        }
+        for (int j = 0; j < rows; j++) {
+            memcpy(d + (size_t)j * dst->stride[p], s + (size_t)j * src->stride[p], src->width);
+        }
+    }
+    return 0;
+}
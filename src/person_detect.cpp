@@ -1,8 +1,17 @@
 #include "person_detect.h"
 #include "vi_vo.h"
+#include "zone.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
 
 // 源码来源：k230_sdk 例程
 
+#define AI2D_CACHE_MAX 4  // 缓存的输入形状数上限（超过后淘汰最久未用的一项，正常运行时只有一种）
+
 // for image
 personDetect::personDetect(const char *kmodel_file, float obj_thresh,float nms_thresh, const int debug_mode) 
 : obj_thresh_(obj_thresh),nms_thresh_(nms_thresh), AIBase(kmodel_file,"personDetect", debug_mode)
@@ -10,6 +19,7 @@ personDetect::personDetect(const char *kmodel_file, float obj_thresh,float nms_t
 
     model_name_ = "personDetect";
     ai2d_out_tensor_ = get_input_tensor(0);
+    init_decoder(kmodel_file);
 }   
 
 // for video
@@ -17,14 +27,13 @@ personDetect::personDetect(const char *kmodel_file, float obj_thresh,float nms_t
 : obj_thresh_(obj_thresh),nms_thresh_(nms_thresh), AIBase(kmodel_file,"personDetect", debug_mode)
 {
     model_name_ = "personDetect";
+    init_decoder(kmodel_file);
     isp_shape_ = isp_shape;
-    dims_t in_shape{1, isp_shape_.channel, isp_shape_.height, isp_shape_.width};
-    int isp_size = isp_shape_.channel * isp_shape_.height * isp_shape_.width;
 
     // ai2d_out_tensor
     ai2d_out_tensor_ = get_input_tensor(0);
     // fixed padding resize param
-    Utils::padding_resize(isp_shape_, {input_shapes_[0][3], input_shapes_[0][2]}, ai2d_builder_, ai2d_in_tensor_, ai2d_out_tensor_, cv::Scalar(114, 114, 114),false);
+    ai2d_lookup(isp_shape_, ai2d_format::NCHW_FMT);
 }
 
 personDetect::~personDetect()
@@ -32,20 +41,152 @@ personDetect::~personDetect()
 
 }
 
-// ai2d for image
-void personDetect::pre_process(cv::Mat ori_img)
+void personDetect::init_decoder(const char *kmodel_file)
+{
+    if (!detect_head_format(output_shapes_, head_format_, classes_num_))
+    {
+        throw std::runtime_error(model_name_ + ": unsupported output layout");
+    }
+    head_quant_.clear();
+    bool quantized = false;
+    for (size_t i = 0; i < output_shapes_.size(); i++)
+    {
+        HeadQuant q = {get_output_tensor(i).datatype(), 1.0f, 0};
+        if (q.type != dt_float32 && q.type != dt_int8 && q.type != dt_uint8)
+        {
+            throw std::runtime_error(model_name_ + ": unsupported output type");
+        }
+        quantized |= (q.type != dt_float32);
+        head_quant_.push_back(q);
+    }
+    if (quantized)
+    {
+        load_head_quant(kmodel_file);
+    }
+    decoders_.clear();
+    for (const auto &q : head_quant_)
+    {
+        const DecoderEntry *d = select_decoder(head_format_, classes_num_, q.type);
+        if (d == nullptr)
+        {
+            throw std::runtime_error(model_name_ + ": no decoder for output head");
+        }
+        decoders_.push_back(d);
+    }
+    std::cout << model_name_ << ": decoder " << decoders_[0]->name << ", " << classes_num_ << " classes" << std::endl;
+}
+
+// 量化参数不在运行时tensor里，取自编译kmodel时的输出，每个输出头一行
+void personDetect::load_head_quant(const char *kmodel_file)
+{
+    std::string path = std::string(kmodel_file) + ".quant";
+    std::ifstream f(path);
+    for (auto &q : head_quant_)
+    {
+        if (!(f >> q.scale >> q.zero_point) || q.scale <= 0)
+        {
+            throw std::runtime_error(model_name_ + ": 8-bit outputs need quant params in " + path);
+        }
+    }
+    std::cout << model_name_ << ": quantized output heads, params from " << path << std::endl;
+}
+
+// ai2d for chw data
+void personDetect::pre_process(FrameCHWSize chw_shape, std::vector<uint8_t>& chw_vec)
+{
+    size_t size = chw_shape.channel * chw_shape.height * chw_shape.width;
+    if (chw_vec.size() < size)
+    {
+        throw std::runtime_error(model_name_ + ": chw data smaller than its shape");
+    }
+    pre_process(chw_shape, chw_vec.data());
+}
+
+void personDetect::pre_process(FrameCHWSize chw_shape, const uint8_t *chw)
+{
+    ScopedTiming st(model_name_ + " pre_process chw", debug_mode_);
+    size_t size = chw_shape.channel * chw_shape.height * chw_shape.width;
+    // 形状不变时builder和输入tensor都复用，每帧只拷数据并invoke
+    Ai2dCacheEntry &e = ai2d_lookup(chw_shape, ai2d_format::NCHW_FMT);
+    if (e.in_tensor.empty())
+    {
+        dims_t in_shape{1, chw_shape.channel, chw_shape.height, chw_shape.width};
+        e.in_tensor = hrt::create(typecode_t::dt_uint8, in_shape, hrt::pool_shared).expect("create ai2d input tensor failed");
+    }
+    auto buf = e.in_tensor.impl()->to_host().unwrap()->buffer().as_host().unwrap().map(map_access_::map_write).unwrap().buffer();
+    memcpy(reinterpret_cast<char *>(buf.data()), chw, size);
+    hrt::sync(e.in_tensor, sync_op_t::sync_write_back, true).expect("sync write_back failed");
+    e.builder->invoke(e.in_tensor, ai2d_out_tensor_).expect("error occurred in ai2d running");
+}
+
+// ai2d for chw data in a caller-owned physically contiguous buffer
+void personDetect::pre_process(FrameCHWSize chw_shape, runtime_tensor& in_tensor)
+{
+    ScopedTiming st(model_name_ + " pre_process chw direct", debug_mode_);
+    ai2d_lookup(chw_shape, ai2d_format::NCHW_FMT).builder->invoke(in_tensor, ai2d_out_tensor_).expect("error occurred in ai2d running");
+}
+
+runtime_tensor personDetect::wrap_input(FrameCHWSize chw_shape, uint8_t *virt, uint64_t phys)
+{
+    dims_t in_shape{1, chw_shape.channel, chw_shape.height, chw_shape.width};
+    size_t size = chw_shape.channel * chw_shape.height * chw_shape.width;
+    return hrt::create(typecode_t::dt_uint8, in_shape, {reinterpret_cast<gsl::byte *>(virt), size}, false, hrt::pool_shared, phys)
+        .expect("wrap ai2d input buffer failed");
+}
+
+personDetect::Ai2dCacheEntry &personDetect::ai2d_lookup(FrameCHWSize shape, ai2d_format format)
+{
+    Ai2dKey key(shape.channel, shape.height, shape.width, (int)format);
+    auto it = ai2d_cache_.find(key);
+    if (it != ai2d_cache_.end())
+    {
+        ai2d_cache_hits_++;
+        it->second.last_used = ++ai2d_cache_tick_;
+        return it->second;
+    }
+    ai2d_cache_misses_++;
+    if (ai2d_cache_.size() >= AI2D_CACHE_MAX)
+    {
+        // 只淘汰最久未用的一项，批量处理多种尺寸的图片时常用尺寸的builder保持缓存
+        auto lru = std::min_element(ai2d_cache_.begin(), ai2d_cache_.end(),
+                                    [](const auto &a, const auto &b) { return a.second.last_used < b.second.last_used; });
+        ai2d_cache_.erase(lru);
+    }
+
+    int net_w = input_shapes_[0][3];
+    int net_h = input_shapes_[0][2];
+    Ai2dCacheEntry &e = ai2d_cache_[key];
+    e.last_used = ++ai2d_cache_tick_;
+    Letterbox lb = make_letterbox(net_w, net_h, shape.width, shape.height);  // 解码时按同样的参数换算坐标
+
+    dims_t in_shape{1, shape.channel, shape.height, shape.width};
+    dims_t out_shape(input_shapes_[0].begin(), input_shapes_[0].end());
+
+    ai2d_datatype_t ai2d_dtype{format, ai2d_format::NCHW_FMT, typecode_t::dt_uint8, typecode_t::dt_uint8};
+    ai2d_crop_param_t crop_param{false, 0, 0, 0, 0};
+    ai2d_shift_param_t shift_param{false, 0};
+    ai2d_pad_param_t pad_param{true, {{0, 0}, {0, 0}, {lb.top, lb.bottom}, {lb.left, lb.right}}, ai2d_pad_mode::constant, {114, 114, 114}};
+    ai2d_resize_param_t resize_param{true, ai2d_interp_method::tf_bilinear, ai2d_interp_mode::half_pixel};
+    ai2d_affine_param_t affine_param{false, ai2d_interp_method::cv2_bilinear, 0, 0, 127, 1, {0.5, 0.1, 0.0, 0.1, 0.5, 0.0}};
+    e.builder.reset(new ai2d_builder(in_shape, out_shape, ai2d_dtype, crop_param, shift_param, pad_param, resize_param, affine_param));
+    e.builder->build_schedule().expect("ai2d build_schedule failed");
+
+    std::cout << model_name_ << ": ai2d builder for " << shape.width << "x" << shape.height
+              << " (gain " << lb.gain << ", pad " << lb.left << "," << lb.top << ")" << std::endl;
+    return e;
+}
+
+void personDetect::ai2d_cache_stats(uint64_t &hits, uint64_t &misses) const
 {
-    ScopedTiming st(model_name_ + " pre_process image", debug_mode_);
-    std::vector<uint8_t> chw_vec;
-    Utils::hwc_to_chw(ori_img, chw_vec);
-    Utils::padding_resize({ori_img.channels(), ori_img.rows, ori_img.cols}, chw_vec, {input_shapes_[0][3], input_shapes_[0][2]}, ai2d_out_tensor_, cv::Scalar(114, 114, 114));
+    hits = ai2d_cache_hits_;
+    misses = ai2d_cache_misses_;
 }
 
 // ai2d for video
 void personDetect::pre_process(runtime_tensor& img_data)
 {
     ScopedTiming st(model_name_ + " pre_process video", debug_mode_);
-    ai2d_builder_->invoke(img_data,ai2d_out_tensor_).expect("error occurred in ai2d running");
+    ai2d_lookup(isp_shape_, ai2d_format::NCHW_FMT).builder->invoke(img_data, ai2d_out_tensor_).expect("error occurred in ai2d running");
 }
 
 void personDetect::inference()
@@ -54,6 +195,21 @@ void personDetect::inference()
     this->get_output();
 }
 
+void personDetect::copy_outputs(std::vector<std::vector<uint8_t>>& outputs)
+{
+    outputs.resize(p_outputs_.size());
+    for (size_t i = 0; i < p_outputs_.size(); i++)
+    {
+        size_t size = (head_quant_[i].type == dt_float32) ? sizeof(float) : 1;
+        for (int d : output_shapes_[i])
+        {
+            size *= d;
+        }
+        const uint8_t *src = reinterpret_cast<const uint8_t *>(p_outputs_[i]);
+        outputs[i].assign(src, src + size);
+    }
+}
+
 static float sigmoid(float x)
 {
     return 1.0f / (1.0f + expf(-x));
@@ -72,6 +228,11 @@ void nms(std::vector<BoxInfo> &input_boxes, float NMS_THRESH)
     {
         for (int j = i + 1; j < int(input_boxes.size());)
         {
+            if (input_boxes[i].label != input_boxes[j].label)   // 按类别分别抑制
+            {
+                j++;
+                continue;
+            }
             float xx1 = std::max(input_boxes[i].x1, input_boxes[j].x1);
             float yy1 = std::max(input_boxes[i].y1, input_boxes[j].y1);
             float xx2 = std::min(input_boxes[i].x2, input_boxes[j].x2);
@@ -93,103 +254,49 @@ void nms(std::vector<BoxInfo> &input_boxes, float NMS_THRESH)
     }
 }
 
-// for NHWC
-std::vector<BoxInfo> decode_infer(float *data, int net_size, int stride, int num_classes, FrameSize frame_size, float anchors[][2], float threshold)
+void personDetect::post_process(FrameSize frame_size,std::vector<BoxInfo> &result)
 {
-    float ratiow = (float)net_size / frame_size.width;
-    float ratioh = (float)net_size / frame_size.height;
-    float gain = ratiow < ratioh ? ratiow : ratioh;
-    std::vector<BoxInfo> result;
-    int grid_size = net_size / stride;
-    int one_rsize = num_classes + 5;
-    float cx, cy, w, h;
-    for (int shift_y = 0; shift_y < grid_size; shift_y++)
-    {
-        for (int shift_x = 0; shift_x < grid_size; shift_x++)
-        {
-            int loc = shift_x + shift_y * grid_size;
-            for (int i = 0; i < 3; i++)
-            {
-                float *record = data + (loc * 3 + i) * one_rsize;
-                float *cls_ptr = record + 5;
-                for (int cls = 0; cls < num_classes; cls++)
-                {
-                    // float score = sigmoid(cls_ptr[cls]) * sigmoid(record[4]);
-                    float score = cls_ptr[cls] * record[4];
-                    if (score > threshold)
-                    {
-                        // cx = (sigmoid(record[0]) * 2.f - 0.5f + (float)shift_x) * (float)stride;
-                        // cy = (sigmoid(record[1]) * 2.f - 0.5f + (float)shift_y) * (float)stride;
-                        // w = pow(sigmoid(record[2]) * 2.f, 2) * anchors[i][0];
-                        // h = pow(sigmoid(record[3]) * 2.f, 2) * anchors[i][1];
-
-                        cx = (record[0] * 2.f - 0.5f + (float)shift_x) * (float)stride;
-                        cy = (record[1] * 2.f - 0.5f + (float)shift_y) * (float)stride;
-                        w = pow(record[2] * 2.f, 2) * anchors[i][0];
-                        h = pow(record[3] * 2.f, 2) * anchors[i][1];
-
-                        cx -= ((net_size - frame_size.width * gain) / 2);
-                        cy -= ((net_size - frame_size.height * gain) / 2);
-                        cx /= gain;
-                        cy /= gain;
-                        w /= gain;
-                        h /= gain;
-                        BoxInfo box;
-                        box.x1 = std::max(0, std::min<int>(frame_size.width, int(cx - w / 2.f)));
-                        box.y1 = std::max(0, std::min<int>(frame_size.height, int(cy - h / 2.f)));
-                        box.x2 = std::max(0, std::min<int>(frame_size.width, int(cx + w / 2.f)));
-                        box.y2 = std::max(0, std::min<int>(frame_size.height, int(cy + h / 2.f)));
-                        box.score = score;
-                        box.label = cls;
-                        result.push_back(box);
-                    }
-                }
-            }
-        }
-    }
-    return result;
+    post_process(frame_size, result, std::vector<const void*>(p_outputs_.begin(), p_outputs_.end()));
 }
 
-
-
-void personDetect::post_process(FrameSize frame_size,std::vector<BoxInfo> &result)
+void personDetect::post_process(FrameSize frame_size,std::vector<BoxInfo> &result, const std::vector<const void*>& outputs)
 {
     ScopedTiming st(model_name_ + " post_process", debug_mode_);
-    int net_len = input_shapes_[0][2];
-    // first output
+    // 区域阈值可以低于全局阈值，解码时取最小值，再由区域过滤
+    // letterbox与ai2d_lookup按同一函数计算（输出与预处理可能在不同线程，不读ai2d缓存）
+    DecodeParams p = { input_shapes_[0][3], input_shapes_[0][2], classes_num_, frame_size,
+                       zone_map_min_score(zones_, obj_thresh_),
+                       make_letterbox(input_shapes_[0][3], input_shapes_[0][2], frame_size.width, frame_size.height) };
+    if (head_format_ == HeadFormat::AnchorV5)
     {
-
-        float *output_0 = p_outputs_[0];
-
-        int first_len = net_len / 8;
-        int first_size = first_len * first_len;
-       
-        auto boxes0 = decode_infer(output_0, net_len, 8, classes_num_, frame_size, anchors_0_, obj_thresh_);
-        result.insert(result.begin(), boxes0.begin(), boxes0.end());
+        const float (*anchors[3])[2] = { anchors_0_, anchors_1_, anchors_2_ };
+        const int strides[3] = { 8, 16, 32 };
+        for (int i = 2; i >= 0; i--)   // 与原先逐头插入到前面的顺序一致
+        {
+            HeadDesc head = { strides[i], p.net_w / strides[i], p.net_h / strides[i], anchors[i], 0 };
+            decoders_[i]->fn(outputs[i], head_quant_[i], head, p, result);
+        }
     }
-
-    // second output
+    else
     {
-
-        float *output_1 = p_outputs_[1];
-
-        int second_len = net_len / 16;
-        int second_size = second_len * second_len;
-
-        auto boxes1 = decode_infer(output_1, net_len, 16, classes_num_, frame_size, anchors_1_, obj_thresh_);
-        result.insert(result.begin(), boxes1.begin(), boxes1.end());
+        HeadDesc head = { 0, 0, 0, nullptr, output_shapes_[0][2] };
+        decoders_[0]->fn(outputs[0], head_quant_[0], head, p, result);
     }
-    
-    // third output
-    {
-        float *output_2 = p_outputs_[2];
 
-        int third_len = net_len / 32;
-        int third_size = third_len * third_len;
-
-        auto boxes2 = decode_infer(output_2, net_len, 32, classes_num_, frame_size, anchors_2_, obj_thresh_);
-        result.insert(result.begin(), boxes2.begin(), boxes2.end());
+    // 在NMS之前过滤，排除区和区域外的框不参与后续任何处理
+    if (zones_ != nullptr && zones_->count > 0)
+    {
+        float sx = (float)zones_->width / frame_size.width;
+        float sy = (float)zones_->height / frame_size.height;
+        result.erase(std::remove_if(result.begin(), result.end(), [&](const BoxInfo &b) {
+            return !zone_map_accept(zones_, b.x1 * sx, b.y1 * sy, b.x2 * sx, b.y2 * sy, b.score, obj_thresh_);
+        }), result.end());
     }
 
     nms(result, nms_thresh_);
 }
+
+void personDetect::set_zones(const zone_map *zones)
+{
+    zones_ = zones;
+}
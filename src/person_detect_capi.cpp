@@ -1,14 +1,23 @@
 #include "person_detect_capi.h"
 #include "person_detect.h"
 #include "show.h"
-#include <opencv2/opencv.hpp>
+#include "nv12.h"
+#include "trace.h"
+#include "profiler.h"
 #include <vector>
 #include <stdint.h>
 #include <time.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
 
 // 全局变量，用于保存模型实例
 static personDetect* g_pd = nullptr;
 
+static struct all_det_location* make_det_location(const std::vector<BoxInfo>& results);
+
 // 初始化函数，加载模型
 bool init_person_detector(const char* model_path, float conf_threshold, float nms_threshold, int num_class) {
     if (g_pd != nullptr) {
@@ -28,122 +37,349 @@ bool init_person_detector(const char* model_path, float conf_threshold, float nm
 // 销毁函数，释放模型资源
 void destroy_person_detector() {
     if (g_pd != nullptr) {
+        uint64_t hits, misses;
+        g_pd->ai2d_cache_stats(hits, misses);
+        fprintf(stderr, "ai2d缓存: 命中%llu次 新建%llu次\n", (unsigned long long)hits, (unsigned long long)misses);
         delete g_pd;
         g_pd = nullptr;
     }
 }
 
-// 检测JPG图像
-void detectjpg() {
+// 预热：用一帧灰色NV12数据跑一遍完整流水线
+// 首次推理会触发KPU/ai2d的内存分配与调度初始化，提前在后台完成
+bool warmup_person_detector(int width, int height) {
     if (g_pd == nullptr) {
         fprintf(stderr, "Error: Person detector not initialized\n");
-        return;
-    }
-    
-    cv::Mat ori_img = cv::imread("./frame_result.jpg");
-    if(ori_img.empty()) {
-        fprintf(stderr, "Error: Failed to load image\n");
-        return; 
+        return false;
     }
-    
-    const int ori_w = ori_img.cols;
-    const int ori_h = ori_img.rows;
-    
-    // 处理流水线
-    g_pd->pre_process(ori_img);
-    g_pd->inference();
+    std::vector<uint8_t> gray(width * height * 3 / 2, 128);
+    struct frame_desc frame = frame_desc_nv12_packed(gray.data(), width, height);
+    free_det_location(detectframe(&frame));
+    return true;
+}
 
-    std::vector<BoxInfo> results;
-    g_pd->post_process({ori_w, ori_h}, results);
+// 设置检测区域：后处理线程会读取区域数据，必须在流水线启动之前设置
+bool set_person_detector_zones(const struct zone_map* zones) {
+    if (g_pd == nullptr) {
+        fprintf(stderr, "Error: Person detector not initialized\n");
+        return false;
+    }
+    g_pd->set_zones(zones);
+    return true;
+}
 
-    // 绘制检测结果
-    for (const auto& r : results) {
-        const std::string text = "person:" + std::to_string(r.score).substr(0, 4);
-        cv::rectangle(ori_img, 
-                     cv::Rect(cv::Point(r.x1, r.y1), cv::Point(r.x2, r.y2)),
-                     cv::Scalar(0, 0, 255), 2);
-        cv::putText(ori_img, text, 
-                   cv::Point(r.x1, r.y1 - 5),
-                   cv::FONT_HERSHEY_SIMPLEX, 0.5,
-                   cv::Scalar(0, 255, 255), 1);
+// 释放检测结果
+void free_det_location(struct all_det_location* all_loc) {
+    if (all_loc == NULL) return;
+    for (int i = 0; i < all_loc->count; i++) {
+        free(all_loc->locations[i]);
     }
-    fprintf(stderr, "Detected %zu persons\n", results.size());
-    cv::imwrite("pd_result.jpg", ori_img);
+    free(all_loc->locations);
+    free(all_loc);
 }
 
 // 检测帧数据
-struct all_det_location* detectframe(uint8_t* nv12_data, int width, int height) {
+struct all_det_location* detectframe(const struct frame_desc* frame) {
     if (g_pd == nullptr) {
         fprintf(stderr, "Error: Person detector not initialized\n");
         return NULL;
     }
-    // 将NV12转换为BGR格式（OpenCV常用格式）
-    cv::Mat nv12_mat(height + height/2, width, CV_8UC1, nv12_data);
-    cv::Mat ori_img;
-    cv::cvtColor(nv12_mat, ori_img, cv::COLOR_YUV2BGR_NV12);
-    if(ori_img.empty()) {
-        fprintf(stderr, "Error: Failed to convert NV12 to BG3P\n");
-        return NULL; 
-    }
-    
-    //fprintf(stderr, "ori_img size: %d x %d\n", ori_img.cols, ori_img.rows);
-    const int ori_w = ori_img.cols;
-    const int ori_h = ori_img.rows;
-    
+    // NV12直接转为平面BGR，交给ai2d缩放填充
+    const int width = frame->width, height = frame->height;
+    std::vector<uint8_t> chw((size_t)width * height * 3);
+    nv12_to_bgr_chw(frame, chw.data());
+
     // 处理流水线
-    g_pd->pre_process(ori_img);
+    g_pd->pre_process({3, (size_t)height, (size_t)width}, chw);
     g_pd->inference();
 
     std::vector<BoxInfo> results;
-    g_pd->post_process({ori_img.cols, ori_img.rows}, results);
+    g_pd->post_process({(size_t)width, (size_t)height}, results);
+
+    return make_det_location(results); // 没有检测到人时返回NULL
+}
 
-    // 如果没有检测到人，直接返回NULL
+static struct all_det_location* make_det_location(const std::vector<BoxInfo>& results) {
     if (results.empty()) {
-        //fprintf(stderr, "No persons detected\n");
         return NULL;
     }
-
-    // 返回的结构体
     struct all_det_location* ret_all = (struct all_det_location*) malloc( sizeof(all_det_location) );
-    ret_all->count = results.size(); // 检测到的行人数量
+    ret_all->count = results.size();
     ret_all->locations = (struct det_location**) malloc( sizeof(struct det_location*) * ret_all->count );
     for( int i = 0; i < ret_all->count; i++ ) {
+        const BoxInfo& r = results[i];
         ret_all->locations[i] = (struct det_location*) malloc( sizeof(struct det_location) );
+        ret_all->locations[i]->x1 = (int)r.x1 -1;
+        ret_all->locations[i]->y1 = (int)r.y1 -1;
+        ret_all->locations[i]->x2 = (int)r.x2 -1;
+        ret_all->locations[i]->y2 = (int)r.y2 -1;
+        ret_all->locations[i]->score = r.score;
     }
+    return ret_all;
+}
 
-    // 绘制检测结果
-    int i = 0;
-    for (const auto& r : results) {
-        const std::string text = "person:" + std::to_string(r.score).substr(0, 4);
-        // 标准化输出格式
-        // printf("[Person] Box: (%.2f, %.2f) -> (%0.2f, %.2f) | Score: %.2f\n", 
-        //         r.x1, r.y1, r.x2, r.y2, r.score);
-        // 将检测结果存入返回结构体
-        ret_all->locations[i]->x1 = (int)r.x1 -1; // 左上角x坐标
-        ret_all->locations[i]->y1 = (int)r.y1 -1; // 左上角y坐标   
-        ret_all->locations[i]->x2 = (int)r.x2 -1; // 右下角x坐标
-        ret_all->locations[i]->y2 = (int)r.y2 -1; // 右下角y坐标
-        ret_all->locations[i]->score = r.score; // 检测得分
-        i++;
-        cv::rectangle(ori_img, 
-                     cv::Rect(cv::Point(r.x1, r.y1), cv::Point(r.x2, r.y2)),
-                     cv::Scalar(0, 0, 255), 2);
-        cv::putText(ori_img, text, 
-                   cv::Point(r.x1, r.y1 - 5),
-                   cv::FONT_HERSHEY_SIMPLEX, 0.5,
-                   cv::Scalar(0, 255, 255), 1);
-    }
-    // fprintf(stderr, "Detected %zu persons\n", results.size());
-    if( results.size() > 0 ){
-        char filename[64];
-        time_t now = time(NULL);
-        struct tm *tm = localtime(&now);
-        snprintf(filename, sizeof(filename), 
-                "./pic/det_%04d%02d%02d_%02d%02d%02d.jpg",
-                tm->tm_year+1900, tm->tm_mon+1, tm->tm_mday,
-                tm->tm_hour, tm->tm_min, tm->tm_sec);
-       // cv::imwrite(filename, ori_img); //耗时60ms
-    }
-   return ret_all; // 返回检测结果位置
+// ---------------------------------------------------------------------------------
+// 异步检测流水线
+// 每个在途帧占一个job，job在 空闲 -> 预处理 -> 推理 -> 后处理 -> (结果) -> 空闲 之间流转；
+// 推理输出在KPU级拷到job里，后处理与下一帧推理互不干扰
+// 预处理输出写进job独占的MMZ帧（物理连续、带缓存），写回缓存后ai2d按物理地址直接读取，不再经过中间数组和输入tensor拷贝
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 
+struct det_job {
+    struct frame_desc frame;                    // 提交的帧（只引用，不拷贝数据）
+    struct det_result result;
+    struct pool_frame* chw;                     // 预处理输出（平面BGR，整个流水线期间归这个job）
+    runtime_tensor chw_tensor;                  // 建在chw上的ai2d输入tensor（帧池退回malloc时为空，改走拷贝）
+    std::vector<std::vector<uint8_t>> outputs;  // 推理输出副本（float或8位量化数据）
+};
+
+// 阻塞队列，close之后取空即返回NULL
+class job_queue {
+public:
+    void push(det_job* job) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(job);
+        cond_.notify_one();
+    }
+    det_job* pop(int timeout_ms = -1) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto ready = [this] { return !jobs_.empty() || closed_; };
+        if (timeout_ms < 0) {
+            cond_.wait(lock, ready);
+        } else if (!cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready)) {
+            return NULL;
+        }
+        if (jobs_.empty()) return NULL;
+        det_job* job = jobs_.front();
+        jobs_.pop_front();
+        return job;
+    }
+    det_job* try_pop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (jobs_.empty()) return NULL;
+        det_job* job = jobs_.front();
+        jobs_.pop_front();
+        return job;
+    }
+    bool empty() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return jobs_.empty();
+    }
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        cond_.notify_all();
+    }
+private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<det_job*> jobs_;
+    bool closed_ = false;
+};
+
+struct det_pipeline {
+    int width, height;
+    det_result_cb cb;
+    void* cb_arg;
+    std::vector<det_job> jobs;
+    struct frame_pool chw_pool;                 // 每个job一帧
+    job_queue free_q, pre_q, kpu_q, post_q, done_q;
+    std::thread threads[DET_STAGE_NUM];
+    int64_t stage_total_ns[DET_STAGE_NUM] = {0};
+    uint64_t completed = 0;
+    int64_t first_submit_ns = 0, last_done_ns = 0;
+};
+
+static det_pipeline* g_pipe = nullptr;
+
+// 预处理：NV12 -> 平面BGR（纯CPU，与KPU推理并行）
+static void det_pre_stage(det_pipeline* p) {
+    thread_policy_apply(ROLE_DETECT);
+    while (det_job* job = p->pre_q.pop()) {
+        int64_t t0 = now_ns();
+        prof_begin("det_pre");
+        nv12_to_bgr_chw(&job->frame, job->chw->virt);
+        pool_frame_flush(job->chw);   // ai2d不经过CPU缓存读取
+        prof_end();
+        int64_t t1 = now_ns();
+        job->result.stage_ns[DET_STAGE_PRE] = t1 - t0;
+        if (trace_on) trace_record("det_pre", (uint32_t)job->result.id, t0, t1);
+        p->kpu_q.push(job);
+    }
+    p->kpu_q.close();
+    thread_policy_exit();
+}
+
+// 推理：ai2d缩放填充 + KPU推理 + 拷出输出（模型实例只在这个线程使用）
+static void det_kpu_stage(det_pipeline* p) {
+    thread_policy_apply(ROLE_DETECT);
+    while (det_job* job = p->kpu_q.pop()) {
+        int64_t t0 = now_ns();
+        prof_begin("det_kpu");
+        FrameCHWSize shape = {3, (size_t)p->height, (size_t)p->width};
+        if (!job->chw_tensor.empty()) {
+            g_pd->pre_process(shape, job->chw_tensor);
+        } else {
+            g_pd->pre_process(shape, job->chw->virt);
+        }
+        g_pd->inference();
+        g_pd->copy_outputs(job->outputs);
+        prof_end();
+        int64_t t1 = now_ns();
+        job->result.stage_ns[DET_STAGE_KPU] = t1 - t0;
+        if (trace_on) trace_record("det_kpu", (uint32_t)job->result.id, t0, t1);
+        p->post_q.push(job);
+    }
+    p->post_q.close();
+    thread_policy_exit();
+}
+
+// 后处理：解码 + NMS，然后回调或放入结果队列
+static void det_post_stage(det_pipeline* p) {
+    thread_policy_apply(ROLE_DETECT);
+    while (det_job* job = p->post_q.pop()) {
+        int64_t t0 = now_ns();
+        prof_begin("det_post");
+        std::vector<const void*> outputs;   // float或8位量化数据，解码器按输出头类型解释
+        for (auto& o : job->outputs) {
+            outputs.push_back(o.data());
+        }
+        std::vector<BoxInfo> results;
+        g_pd->post_process({(size_t)p->width, (size_t)p->height}, results, outputs);
+        job->result.locations = make_det_location(results);
+        prof_end();
+        int64_t t1 = now_ns();
+        job->result.stage_ns[DET_STAGE_POST] = t1 - t0;
+        if (trace_on) trace_record("det_post", (uint32_t)job->result.id, t0, t1);
+
+        for (int s = 0; s < DET_STAGE_NUM; s++) {
+            p->stage_total_ns[s] += job->result.stage_ns[s];
+        }
+        p->completed++;
+        p->last_done_ns = t1;
+        if (p->cb) {
+            int64_t tr = trace_begin();
+            p->cb(&job->result, p->cb_arg);
+            trace_end("det_callback", (uint32_t)job->result.id, tr);
+            p->free_q.push(job);
+        } else {
+            p->done_q.push(job);
+        }
+    }
+    p->done_q.close();
+    thread_policy_exit();
+}
+
+// 先释放引用缓冲区的tensor，再把缓冲区还给帧池
+static void det_pipeline_free(det_pipeline* p) {
+    for (auto& job : p->jobs) {
+        job.chw_tensor = runtime_tensor();
+        pool_frame_put(job.chw);
+        job.chw = NULL;
+    }
+    frame_pool_destroy(&p->chw_pool);
+    delete p;
+}
+
+bool det_async_start(int width, int height, int depth, det_result_cb cb, void* arg) {
+    if (g_pd == nullptr || g_pipe != nullptr || depth < 1) {
+        fprintf(stderr, "Error: 异步检测无法启动\n");
+        return false;
+    }
+    det_pipeline* p = new det_pipeline();
+    p->width = width;
+    p->height = height;
+    p->cb = cb;
+    p->cb_arg = arg;
+    p->jobs.resize(depth);
+    if (frame_pool_init(&p->chw_pool, "det_chw", (size_t)width * height * 3, depth) != 0) {
+        fprintf(stderr, "Error: 检测预处理缓冲区分配失败\n");
+        delete p;
+        return false;
+    }
+    FrameCHWSize shape = {3, (size_t)height, (size_t)width};
+    for (auto& job : p->jobs) {
+        job.chw = frame_pool_get(&p->chw_pool);
+        if (job.chw->phys) {
+            job.chw_tensor = personDetect::wrap_input(shape, job.chw->virt, job.chw->phys);
+        }
+        p->free_q.push(&job);
+    }
+    try {
+        p->threads[DET_STAGE_PRE] = std::thread(det_pre_stage, p);
+        p->threads[DET_STAGE_KPU] = std::thread(det_kpu_stage, p);
+        p->threads[DET_STAGE_POST] = std::thread(det_post_stage, p);
+    } catch (...) {
+        fprintf(stderr, "Error: 无法创建检测流水线线程\n");
+        p->pre_q.close();
+        for (auto& t : p->threads) {
+            if (t.joinable()) t.join();
+        }
+        det_pipeline_free(p);
+        return false;
+    }
+    g_pipe = p;
+    fprintf(stderr, "异步检测已启动: 在途%d帧\n", depth);
+    return true;
+}
+
+bool det_async_ready(void) {
+    return g_pipe != nullptr && !g_pipe->free_q.empty();
+}
+
+int det_async_submit(const struct frame_desc* frame, uint64_t id, int64_t timestamp_ns, void* user) {
+    if (g_pipe == nullptr) return -1;
+    if (frame->fourcc != FRAME_FMT_NV12 || frame->width != g_pipe->width || frame->height != g_pipe->height) {
+        fprintf(stderr, "Error: 检测输入帧尺寸不符 %dx%d\n", frame->width, frame->height);
+        return -1;
+    }
+    det_job* job = g_pipe->free_q.try_pop();
+    if (job == NULL) return 1;
+    job->frame = *frame;
+    memset(&job->result, 0, sizeof(job->result));
+    job->result.id = id;
+    job->result.timestamp_ns = timestamp_ns;
+    job->result.user = user;
+    if (g_pipe->first_submit_ns == 0) {
+        g_pipe->first_submit_ns = now_ns();
+    }
+    g_pipe->pre_q.push(job);
+    return 0;
+}
+
+bool det_async_poll(struct det_result* result, int timeout_ms) {
+    if (g_pipe == nullptr || g_pipe->cb) return false;
+    det_job* job = g_pipe->done_q.pop(timeout_ms);
+    if (job == NULL) return false;
+    *result = job->result;
+    g_pipe->free_q.push(job);
+    return true;
+}
+
+void det_async_stop(void) {
+    det_pipeline* p = g_pipe;
+    if (p == nullptr) return;
+    p->pre_q.close();   // 各级处理完队列中的帧后依次退出
+    for (auto& t : p->threads) {
+        t.join();
+    }
+    if (p->completed > 0) {
+        double seconds = (p->last_done_ns - p->first_submit_ns) / 1e9;
+        fprintf(stderr, "异步检测: %llu帧 吞吐%.1f帧/秒 平均耗时 预处理%.1fms 推理%.1fms 后处理%.1fms\n",
+                (unsigned long long)p->completed, seconds > 0 ? p->completed / seconds : 0.0,
+                p->stage_total_ns[DET_STAGE_PRE] / 1e6 / p->completed,
+                p->stage_total_ns[DET_STAGE_KPU] / 1e6 / p->completed,
+                p->stage_total_ns[DET_STAGE_POST] / 1e6 / p->completed);
+    }
+    // 轮询模式下未取走的结果在这里释放
+    while (det_job* job = p->done_q.try_pop()) {
+        free_det_location(job->result.locations);
+    }
+    g_pipe = nullptr;
+    det_pipeline_free(p);
+}
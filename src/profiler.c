@@ -0,0 +1,631 @@
+#define _GNU_SOURCE
+#include "profiler.h"
+#include "thread_policy.h"
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+// 阶段计数器（同一组，一次read读出）
+enum { CNT_TASK_CLOCK = 0, CNT_CYCLES, CNT_INSTRUCTIONS, CNT_CACHE_MISSES, CNT_NUM };
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} cnt_events[CNT_NUM] = {
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+};
+
+struct prof_stage {
+    const char* name;
+    uint64_t calls;
+    uint64_t sum[CNT_NUM];
+};
+
+// 每线程的计数器与阶段累计（只有所属线程写，报告在线程退出后读）
+struct prof_thread {
+    int tid;
+    char name[16];
+    int fd[CNT_NUM];      // fd[0]为组长（任务时钟），硬件计数器打不开时为-1
+    int slot[CNT_NUM];    // 在组读取结果中的位置，-1为不可用
+    int nr;
+    int depth;
+    struct {
+        int stage;
+        uint64_t v[CNT_NUM];
+    } stack[PROF_STAGE_DEPTH];
+    int stage_count;
+    struct prof_stage stages[PROF_MAX_STAGES];
+};
+
+// 采样地址统计：按(地址, 线程)开放寻址
+#define PROF_HASH_BITS 16
+#define PROF_HASH_SIZE (1u << PROF_HASH_BITS)
+
+struct prof_sample {
+    uint64_t ip;
+    uint32_t tid;
+    uint32_t count;
+};
+
+struct prof_tid {
+    int tid;
+    char name[16];
+    uint64_t samples;
+};
+
+// 符号表（nm -n输出，按地址升序）
+struct prof_sym {
+    uint64_t addr;
+    char* name;
+};
+
+// 可执行映射（/proc/self/maps）
+struct prof_map {
+    uint64_t start, end, offset;
+    char path[256];
+    char label[64];   // 报告中显示的名字：[库文件名]
+    bool exe;
+};
+
+int prof_on = 0;
+
+static struct {
+    FILE* out;
+    char out_path[256];
+    char sym_path[256];
+    bool hw_sampling;              // 采样事件为CPU周期（否则为CPU时钟）
+    int cpu_count;
+    int fd[PROF_MAX_CPUS];         // 每个CPU一个采样事件（继承到之后创建的线程）
+    uint8_t* ring[PROF_MAX_CPUS];
+    size_t page_size;
+    pthread_t thread;
+    bool running;
+    pthread_mutex_t lock;          // 保护线程登记和running
+    pthread_cond_t cond;
+    struct prof_sample* hash;
+    uint64_t samples, lost, hash_full;
+    struct prof_tid tids[PROF_MAX_THREADS * 2];
+    int tid_count;
+    struct prof_thread* threads[PROF_MAX_THREADS];
+    int thread_count;
+    int64_t t0;
+} g_prof = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+static __thread struct prof_thread* tls_prof;
+static __thread bool tls_tried;   // 已尝试登记（失败时不再重试）
+
+static int perf_open(struct perf_event_attr* attr, int group_fd) {
+    return (int)syscall(SYS_perf_event_open, attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+/*---------------- 阶段计数 ----------------*/
+
+// 第一次进入阶段时为本线程打开计数器组
+static struct prof_thread* prof_thread_get(void) {
+    if (tls_prof || tls_tried) return tls_prof;
+    tls_tried = true;
+    struct prof_thread* t = calloc(1, sizeof(*t));
+    if (!t) return NULL;
+    t->tid = (int)syscall(SYS_gettid);
+    pthread_getname_np(pthread_self(), t->name, sizeof(t->name));
+    for (int c = 0; c < CNT_NUM; c++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = cnt_events[c].type;
+        attr.config = cnt_events[c].config;
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        t->fd[c] = perf_open(&attr, c == 0 ? -1 : t->fd[0]);
+        t->slot[c] = t->fd[c] >= 0 ? t->nr++ : -1;
+        if (c == 0 && t->fd[0] < 0) {
+            fprintf(stderr, "线程%s: 打开计数器失败: %s\n", t->name, strerror(errno));
+            free(t);
+            return NULL;
+        }
+    }
+
+    pthread_mutex_lock(&g_prof.lock);
+    if (g_prof.thread_count < PROF_MAX_THREADS) {
+        g_prof.threads[g_prof.thread_count++] = t;
+        tls_prof = t;
+    }
+    pthread_mutex_unlock(&g_prof.lock);
+    if (!tls_prof) {
+        for (int c = 0; c < CNT_NUM; c++) {
+            if (t->fd[c] >= 0) close(t->fd[c]);
+        }
+        free(t);
+    }
+    return tls_prof;
+}
+
+static bool prof_read(const struct prof_thread* t, uint64_t v[CNT_NUM]) {
+    uint64_t buf[1 + CNT_NUM];
+    if (read(t->fd[0], buf, sizeof(buf)) < (ssize_t)(sizeof(uint64_t) * (1 + t->nr))) {
+        return false;
+    }
+    for (int c = 0; c < CNT_NUM; c++) {
+        v[c] = t->slot[c] >= 0 ? buf[1 + t->slot[c]] : 0;
+    }
+    return true;
+}
+
+void prof_stage_push(const char* stage) {
+    struct prof_thread* t = prof_thread_get();
+    if (!t) return;
+    if (t->depth++ >= PROF_STAGE_DEPTH) return;   // 超出深度的阶段只计层数，不统计
+    int idx = -1;
+    for (int i = 0; i < t->stage_count; i++) {
+        if (strcmp(t->stages[i].name, stage) == 0) {   // C和C++中的同名字符串常量地址不同
+            idx = i;
+            break;
+        }
+    }
+    if (idx < 0 && t->stage_count < PROF_MAX_STAGES) {
+        idx = t->stage_count++;
+        t->stages[idx].name = stage;
+    }
+    t->stack[t->depth - 1].stage = idx;
+    if (idx >= 0 && !prof_read(t, t->stack[t->depth - 1].v)) {
+        t->stack[t->depth - 1].stage = -1;
+    }
+}
+
+void prof_stage_pop(void) {
+    struct prof_thread* t = tls_prof;
+    if (!t || t->depth == 0) return;
+    if (--t->depth >= PROF_STAGE_DEPTH) return;
+    int idx = t->stack[t->depth].stage;
+    uint64_t now[CNT_NUM];
+    if (idx < 0 || !prof_read(t, now)) return;
+    struct prof_stage* s = &t->stages[idx];
+    for (int c = 0; c < CNT_NUM; c++) {
+        s->sum[c] += now[c] - t->stack[t->depth].v[c];
+    }
+    s->calls++;
+}
+
+/*---------------- 采样 ----------------*/
+
+static struct prof_tid* tid_lookup(int tid) {
+    for (int i = 0; i < g_prof.tid_count; i++) {
+        if (g_prof.tids[i].tid == tid) return &g_prof.tids[i];
+    }
+    if (g_prof.tid_count >= (int)(sizeof(g_prof.tids) / sizeof(g_prof.tids[0]))) return NULL;
+    // 第一次见到这个线程时读取线程名（线程启动时已在thread_policy_apply中命名）
+    struct prof_tid* t = &g_prof.tids[g_prof.tid_count++];
+    t->tid = tid;
+    snprintf(t->name, sizeof(t->name), "%d", tid);
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/comm", tid);
+    FILE* fp = fopen(path, "r");
+    if (fp) {
+        if (fgets(t->name, sizeof(t->name), fp)) {
+            t->name[strcspn(t->name, "\n")] = '\0';
+        }
+        fclose(fp);
+    }
+    return t;
+}
+
+static void sample_add(uint64_t ip, uint32_t tid) {
+    struct prof_tid* t = tid_lookup((int)tid);
+    if (t) t->samples++;
+    g_prof.samples++;
+    uint32_t h = (uint32_t)(((ip >> 1) ^ ((uint64_t)tid << 40)) * 0x9E3779B97F4A7C15ull >> (64 - PROF_HASH_BITS));
+    for (uint32_t n = 0; n < PROF_HASH_SIZE; n++, h = (h + 1) & (PROF_HASH_SIZE - 1)) {
+        struct prof_sample* s = &g_prof.hash[h];
+        if (s->count == 0) {
+            s->ip = ip;
+            s->tid = tid;
+            s->count = 1;
+            return;
+        }
+        if (s->ip == ip && s->tid == tid) {
+            s->count++;
+            return;
+        }
+    }
+    g_prof.hash_full++;
+}
+
+// 从环形缓冲区拷出（记录可能跨越缓冲区末尾）
+static void ring_copy(void* dst, const uint8_t* data, uint64_t size, uint64_t pos, size_t len) {
+    uint64_t off = pos & (size - 1);
+    size_t first = len < size - off ? len : (size_t)(size - off);
+    memcpy(dst, data + off, first);
+    memcpy((uint8_t*)dst + first, data, len - first);
+}
+
+// 取出一个CPU缓冲区中的采样记录（只在读取线程和profiler_stop中调用）
+static void prof_drain_ring(uint8_t* ring) {
+    struct perf_event_mmap_page* mp = (struct perf_event_mmap_page*)ring;
+    const uint8_t* data = ring + g_prof.page_size;
+    uint64_t size = (uint64_t)PROF_RING_PAGES * g_prof.page_size;
+    uint64_t head = __atomic_load_n(&mp->data_head, __ATOMIC_ACQUIRE);
+    uint64_t tail = mp->data_tail;
+    while (tail < head) {
+        struct perf_event_header hdr;
+        ring_copy(&hdr, data, size, tail, sizeof(hdr));
+        if (hdr.size < sizeof(hdr)) break;
+        uint64_t rec[8];   // 记录：头 + ip + pid/tid，或头 + id + 丢失数
+        if (hdr.size <= sizeof(rec)) {
+            ring_copy(rec, data, size, tail, hdr.size);
+            if (hdr.type == PERF_RECORD_SAMPLE) {
+                sample_add(rec[1], (uint32_t)(rec[2] >> 32));
+            } else if (hdr.type == PERF_RECORD_LOST) {
+                g_prof.lost += rec[2];
+            }
+        }
+        tail += hdr.size;
+    }
+    __atomic_store_n(&mp->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+static void prof_drain(void) {
+    for (int c = 0; c < g_prof.cpu_count; c++) {
+        prof_drain_ring(g_prof.ring[c]);
+    }
+}
+
+static void* prof_thread_main(void* arg) {
+    (void)arg;
+    thread_policy_apply(ROLE_WRITER);
+    pthread_mutex_lock(&g_prof.lock);
+    while (g_prof.running) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += PROF_POLL_MS * 1000000L;
+        ts.tv_sec += ts.tv_nsec / 1000000000L;
+        ts.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&g_prof.cond, &g_prof.lock, &ts);
+        pthread_mutex_unlock(&g_prof.lock);
+        prof_drain();
+        pthread_mutex_lock(&g_prof.lock);
+    }
+    pthread_mutex_unlock(&g_prof.lock);
+    thread_policy_exit();
+    return NULL;
+}
+
+/*
+* 采样事件：优先CPU周期，硬件计数器不可用时用CPU时钟
+* 内核不允许映射继承的单线程事件，所以像perf record一样每个CPU打开一个（本进程在该CPU上运行时采样）
+*/
+static int open_sampler(int cpu) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = g_prof.hw_sampling ? PERF_TYPE_HARDWARE : PERF_TYPE_SOFTWARE;
+    attr.config = g_prof.hw_sampling ? PERF_COUNT_HW_CPU_CYCLES : PERF_COUNT_SW_CPU_CLOCK;
+    attr.freq = 1;
+    attr.sample_freq = PROF_SAMPLE_HZ;
+    attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID;
+    attr.inherit = 1;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+static void close_samplers(void) {
+    for (int c = 0; c < g_prof.cpu_count; c++) {
+        if (g_prof.ring[c]) munmap(g_prof.ring[c], (PROF_RING_PAGES + 1) * g_prof.page_size);
+        close(g_prof.fd[c]);
+        g_prof.ring[c] = NULL;
+    }
+    g_prof.cpu_count = 0;
+}
+
+int profiler_start(const char* out_path, const char* sym_path) {
+    if (prof_on) return 0;
+    g_prof.out = fopen(out_path, "w");
+    if (!g_prof.out) {
+        perror("打开分析输出文件失败");
+        return -1;
+    }
+    snprintf(g_prof.out_path, sizeof(g_prof.out_path), "%s", out_path);
+    if (sym_path) {
+        snprintf(g_prof.sym_path, sizeof(g_prof.sym_path), "%s", sym_path);
+    } else {
+        char exe[240];
+        ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+        exe[n > 0 ? n : 0] = '\0';
+        snprintf(g_prof.sym_path, sizeof(g_prof.sym_path), "%s.sym", exe);
+    }
+
+    g_prof.hash = calloc(PROF_HASH_SIZE, sizeof(*g_prof.hash));
+    if (!g_prof.hash) {
+        fprintf(stderr, "分配采样统计表失败\n");
+        goto fail;
+    }
+    g_prof.page_size = (size_t)sysconf(_SC_PAGESIZE);
+    int cpus = (int)sysconf(_SC_NPROCESSORS_CONF);
+    if (cpus > PROF_MAX_CPUS) cpus = PROF_MAX_CPUS;
+    g_prof.hw_sampling = true;
+    for (int c = 0; c < cpus; c++) {
+        int fd = open_sampler(c);
+        if (fd < 0 && c == 0 && g_prof.hw_sampling) {
+            g_prof.hw_sampling = false;
+            fd = open_sampler(c);
+        }
+        if (fd < 0) {
+            if (errno == ENODEV || errno == EINVAL) continue;   // CPU离线
+            fprintf(stderr, "打开CPU%d采样事件失败: %s（内核需要CONFIG_PERF_EVENTS）\n", c, strerror(errno));
+            goto fail;
+        }
+        void* ring = mmap(NULL, (PROF_RING_PAGES + 1) * g_prof.page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        g_prof.fd[g_prof.cpu_count] = fd;
+        g_prof.ring[g_prof.cpu_count++] = ring == MAP_FAILED ? NULL : ring;
+        if (ring == MAP_FAILED) {
+            perror("映射采样缓冲区失败");
+            goto fail;
+        }
+    }
+    if (g_prof.cpu_count == 0) {
+        fprintf(stderr, "没有可用的CPU采样事件\n");
+        goto fail;
+    }
+    g_prof.running = true;
+    if (pthread_create(&g_prof.thread, NULL, prof_thread_main, NULL)) {
+        fprintf(stderr, "无法创建采样读取线程\n");
+        g_prof.running = false;
+        goto fail;
+    }
+    g_prof.t0 = monotonic_ns();
+    for (int c = 0; c < g_prof.cpu_count; c++) {
+        ioctl(g_prof.fd[c], PERF_EVENT_IOC_ENABLE, 0);
+    }
+    prof_on = 1;
+    fprintf(stderr, "性能分析: 采样%s %dHz %d个CPU，报告写入%s\n",
+            g_prof.hw_sampling ? "CPU周期" : "CPU时钟", PROF_SAMPLE_HZ, g_prof.cpu_count, out_path);
+    return 0;
+
+fail:
+    close_samplers();
+    free(g_prof.hash);
+    g_prof.hash = NULL;
+    fclose(g_prof.out);
+    g_prof.out = NULL;
+    return -1;
+}
+
+/*---------------- 符号化与报告 ----------------*/
+
+static struct prof_sym* load_symbols(const char* path, int* count) {
+    *count = 0;
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "性能分析: 没有符号表%s，只输出地址（用make生成的.sym文件）\n", path);
+        return NULL;
+    }
+    int cap = 4096;
+    struct prof_sym* syms = malloc(cap * sizeof(*syms));
+    char line[512];
+    while (syms && fgets(line, sizeof(line), fp)) {
+        unsigned long long addr;
+        char type;
+        int name_at = 0;
+        // nm -n -C --defined-only：地址 类型 名字（C++名字中可能带空格）
+        if (sscanf(line, "%llx %c %n", &addr, &type, &name_at) < 2 || !name_at) continue;
+        if (type != 't' && type != 'T' && type != 'w' && type != 'W') continue;
+        line[strcspn(line, "\n")] = '\0';
+        if (*count == cap) {
+            cap *= 2;
+            struct prof_sym* p = realloc(syms, cap * sizeof(*syms));
+            if (!p) break;
+            syms = p;
+        }
+        syms[*count].addr = addr;
+        syms[*count].name = strdup(line + name_at);
+        (*count)++;
+    }
+    fclose(fp);
+    return syms;
+}
+
+static int load_maps(struct prof_map* maps, int max) {
+    char exe[256];
+    ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    exe[n > 0 ? n : 0] = '\0';
+    FILE* fp = fopen("/proc/self/maps", "r");
+    if (!fp) return 0;
+    int count = 0;
+    char line[512];
+    while (count < max && fgets(line, sizeof(line), fp)) {
+        unsigned long long start, end, offset;
+        char perms[8];
+        int path_at = 0;
+        if (sscanf(line, "%llx-%llx %7s %llx %*s %*s %n", &start, &end, perms, &offset, &path_at) < 4) continue;
+        if (perms[2] != 'x') continue;
+        struct prof_map* m = &maps[count++];
+        m->start = start;
+        m->end = end;
+        m->offset = offset;
+        line[strcspn(line, "\n")] = '\0';
+        snprintf(m->path, sizeof(m->path), "%s", path_at ? line + path_at : "");
+        const char* base = strrchr(m->path, '/');
+        snprintf(m->label, sizeof(m->label), "[%s]", base ? base + 1 : (m->path[0] ? m->path : "anon"));
+        m->exe = exe[0] && strcmp(m->path, exe) == 0;
+    }
+    fclose(fp);
+    return count;
+}
+
+struct prof_resolved {
+    const char* name;          // 函数名或[库名]
+    const struct prof_map* map;
+    uint64_t offset;           // 可执行文件中为链接地址，库中为文件偏移（离线addr2line用）
+};
+
+static struct prof_resolved resolve(uint64_t ip, const struct prof_map* maps, int map_count,
+                                    const struct prof_sym* syms, int sym_count, int64_t bias) {
+    struct prof_resolved r = { "[unknown]", NULL, ip };
+    for (int i = 0; i < map_count; i++) {
+        if (ip < maps[i].start || ip >= maps[i].end) continue;
+        r.map = &maps[i];
+        r.name = maps[i].label;
+        r.offset = ip - maps[i].start + maps[i].offset;
+        break;
+    }
+    if (r.map && r.map->exe && sym_count > 0) {
+        uint64_t addr = ip - bias;
+        int lo = 0, hi = sym_count - 1, found = -1;
+        while (lo <= hi) {
+            int mid = (lo + hi) / 2;
+            if (syms[mid].addr <= addr) {
+                found = mid;
+                lo = mid + 1;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        if (found >= 0) r.name = syms[found].name;
+        r.offset = addr;
+    }
+    return r;
+}
+
+struct prof_hot {
+    const char* name;
+    uint64_t count;
+};
+
+static int hot_cmp(const void* a, const void* b) {
+    const struct prof_hot* x = a;
+    const struct prof_hot* y = b;
+    return x->count < y->count ? 1 : (x->count > y->count ? -1 : 0);
+}
+
+// 按函数汇总一个线程（tid<0为全部线程）的样本，写出前PROF_TOP_SYMBOLS个
+static void report_hot(FILE* fp, int tid, uint64_t total, const struct prof_map* maps, int map_count,
+                       const struct prof_sym* syms, int sym_count, int64_t bias) {
+    int cap = 256, n = 0;
+    struct prof_hot* hot = malloc(cap * sizeof(*hot));
+    if (!hot || total == 0) {
+        free(hot);
+        return;
+    }
+    for (uint32_t i = 0; i < PROF_HASH_SIZE; i++) {
+        const struct prof_sample* s = &g_prof.hash[i];
+        if (!s->count || (tid >= 0 && (int)s->tid != tid)) continue;
+        const char* name = resolve(s->ip, maps, map_count, syms, sym_count, bias).name;
+        int k = 0;
+        while (k < n && hot[k].name != name) k++;   // 名字来自符号表或映射表，按指针比较
+        if (k == n) {
+            if (n == cap) {
+                struct prof_hot* p = realloc(hot, cap * 2 * sizeof(*hot));
+                if (!p) break;
+                hot = p;
+                cap *= 2;
+            }
+            hot[n].name = name;
+            hot[n].count = 0;
+            n++;
+        }
+        hot[k].count += s->count;
+    }
+    qsort(hot, n, sizeof(*hot), hot_cmp);
+    for (int k = 0; k < n && k < PROF_TOP_SYMBOLS; k++) {
+        fprintf(fp, "  %6.2f%% %8llu  %s\n", 100.0 * hot[k].count / total, (unsigned long long)hot[k].count, hot[k].name);
+    }
+    free(hot);
+}
+
+static void report_stages(FILE* fp) {
+    static const char* cnt_labels[CNT_NUM] = { "CPU时间", "周期", "指令", "缓存缺失" };
+    fprintf(fp, "\n# 阶段计数（每次平均；-表示该计数器不可用）\n");
+    fprintf(fp, "%-14s %-16s %8s %12s %14s %14s %6s %12s\n", "线程", "阶段", "次数",
+            cnt_labels[CNT_TASK_CLOCK], cnt_labels[CNT_CYCLES], cnt_labels[CNT_INSTRUCTIONS], "IPC",
+            cnt_labels[CNT_CACHE_MISSES]);
+    for (int i = 0; i < g_prof.thread_count; i++) {
+        const struct prof_thread* t = g_prof.threads[i];
+        for (int k = 0; k < t->stage_count; k++) {
+            const struct prof_stage* s = &t->stages[k];
+            if (!s->calls) continue;
+            char cyc[24] = "-", ins[24] = "-", ipc[16] = "-", miss[24] = "-";
+            if (t->slot[CNT_CYCLES] >= 0) snprintf(cyc, sizeof(cyc), "%llu", (unsigned long long)(s->sum[CNT_CYCLES] / s->calls));
+            if (t->slot[CNT_INSTRUCTIONS] >= 0) snprintf(ins, sizeof(ins), "%llu", (unsigned long long)(s->sum[CNT_INSTRUCTIONS] / s->calls));
+            if (t->slot[CNT_CYCLES] >= 0 && t->slot[CNT_INSTRUCTIONS] >= 0 && s->sum[CNT_CYCLES]) {
+                snprintf(ipc, sizeof(ipc), "%.2f", (double)s->sum[CNT_INSTRUCTIONS] / s->sum[CNT_CYCLES]);
+            }
+            if (t->slot[CNT_CACHE_MISSES] >= 0) snprintf(miss, sizeof(miss), "%llu", (unsigned long long)(s->sum[CNT_CACHE_MISSES] / s->calls));
+            fprintf(fp, "%-14s %-16s %8llu %10.3fms %14s %14s %6s %12s\n", t->name, s->name,
+                    (unsigned long long)s->calls, s->sum[CNT_TASK_CLOCK] / 1e6 / s->calls, cyc, ins, ipc, miss);
+        }
+    }
+}
+
+// 原始地址：可执行文件为链接地址（addr2line -e camera.debug），库为文件偏移
+static void report_raw(FILE* fp, const struct prof_map* maps, int map_count,
+                       const struct prof_sym* syms, int sym_count, int64_t bias) {
+    fprintf(fp, "\n# 原始样本：tid 模块 地址 次数\n");
+    for (uint32_t i = 0; i < PROF_HASH_SIZE; i++) {
+        const struct prof_sample* s = &g_prof.hash[i];
+        if (!s->count) continue;
+        struct prof_resolved r = resolve(s->ip, maps, map_count, syms, sym_count, bias);
+        fprintf(fp, "raw %u %s 0x%llx %u\n", s->tid, r.map ? (r.map->path[0] ? r.map->path : r.map->label) : "?",
+                (unsigned long long)r.offset, s->count);
+    }
+}
+
+void profiler_stop(void) {
+    if (!prof_on) return;
+    prof_on = 0;
+    for (int c = 0; c < g_prof.cpu_count; c++) {
+        ioctl(g_prof.fd[c], PERF_EVENT_IOC_DISABLE, 0);   // 同时停止继承出去的事件
+    }
+    pthread_mutex_lock(&g_prof.lock);
+    g_prof.running = false;
+    pthread_cond_signal(&g_prof.cond);
+    pthread_mutex_unlock(&g_prof.lock);
+    pthread_join(g_prof.thread, NULL);
+    prof_drain();
+    double seconds = (monotonic_ns() - g_prof.t0) / 1e9;
+
+    // 符号表中的地址是链接地址；用本文件中一个函数的实际地址算出加载偏移（PIE和非PIE都适用）
+    int sym_count = 0;
+    struct prof_sym* syms = load_symbols(g_prof.sym_path, &sym_count);
+    int64_t bias = 0;
+    for (int i = 0; i < sym_count; i++) {
+        if (strcmp(syms[i].name, "profiler_start") == 0) {
+            bias = (int64_t)((uintptr_t)profiler_start - syms[i].addr);
+            break;
+        }
+    }
+    struct prof_map maps[128];
+    int map_count = load_maps(maps, 128);
+
+    FILE* fp = g_prof.out;
+    fprintf(fp, "# 采样: %s %dHz 用户态, 时长%.1fs, 样本%llu, 丢失%llu, 统计表满丢弃%llu\n",
+            g_prof.hw_sampling ? "CPU周期" : "CPU时钟", PROF_SAMPLE_HZ, seconds,
+            (unsigned long long)g_prof.samples, (unsigned long long)g_prof.lost, (unsigned long long)g_prof.hash_full);
+    fprintf(fp, "# 符号表: %s（%d个函数）\n", g_prof.sym_path, sym_count);
+    fprintf(fp, "\n# 全部线程热点\n");
+    report_hot(fp, -1, g_prof.samples, maps, map_count, syms, sym_count, bias);
+    for (int i = 0; i < g_prof.tid_count; i++) {
+        const struct prof_tid* t = &g_prof.tids[i];
+        fprintf(fp, "\n# 线程 %s（tid %d）样本%llu，约%.1f%% CPU\n", t->name, t->tid, (unsigned long long)t->samples,
+                seconds > 0 ? 100.0 * t->samples / PROF_SAMPLE_HZ / seconds : 0.0);
+        report_hot(fp, t->tid, t->samples, maps, map_count, syms, sym_count, bias);
+    }
+    report_stages(fp);
+    report_raw(fp, maps, map_count, syms, sym_count, bias);
+    fclose(fp);
+    g_prof.out = NULL;
+    fprintf(stderr, "性能分析: 样本%llu 丢失%llu，报告已写入%s\n", (unsigned long long)g_prof.samples,
+            (unsigned long long)g_prof.lost, g_prof.out_path);
+
+    for (int i = 0; i < sym_count; i++) {
+        free(syms[i].name);
+    }
+    free(syms);
+    close_samplers();
+    free(g_prof.hash);
+    g_prof.hash = NULL;
+    // 计数器保留到进程退出：其他线程可能仍持有自己的计数器
+}
@@ -1,8 +1,205 @@
 #include "saveVideo.h"
+#include "thread_policy.h"
+
+#define ROI_MARGIN 16   // ROI在检测框基础上外扩的像素（检测结果比当前帧晚，留出运动余量）
+#define SEG_IO_BUFFER (64 * 1024)   // 分段输出的AVIO缓冲区
+
+// AVIO回调：muxer输出直接写入分段文件
+static int seg_write_cb(void* opaque, uint8_t* buf, int len) {
+    return segment_writer_write((struct segment_writer*)opaque, buf, len);
+}
+
+static int64_t seg_seek_cb(void* opaque, int64_t offset, int whence) {
+    struct segment_writer* sw = (struct segment_writer*)opaque;
+    if (whence == AVSEEK_SIZE) {
+        return sw->size;
+    }
+    return segment_writer_seek(sw, offset, whence & ~AVSEEK_FORCE);
+}
+
+/*
+* 打开输出（单文件或一个新的分段）
+* 分段模式使用分片MP4（frag_keyframe+empty_moov）：moov在文件开头，每个关键帧开始一个独立的分片，
+* 写完即完整，掉电只丢最后一个未写完的分片，也不会在结束时集中写一个大的moov
+* @return: 0 成功, -1 失败
+*/
+static int muxer_open(VideoEncoder* enc) {
+    AVDictionary* opts = NULL;
+    enc->header_written = 0;
+    enc->seg_first_pts = AV_NOPTS_VALUE;
+    enc->last_mux_pts = AV_NOPTS_VALUE;
+    if (!enc->output_file && !enc->output_dir) {
+        return 0;  // 只编码（如实时流子码流），不写文件
+    }
+    // 创建输出上下文
+    if (avformat_alloc_output_context2(&enc->fmt_ctx, NULL, enc->output_dir ? "mp4" : NULL,
+                                       enc->output_dir ? NULL : enc->output_file) < 0) {
+        fprintf(stderr, "无法创建输出上下文\n");
+        return -1;
+    }
+    // 创建输出流
+    enc->stream = avformat_new_stream(enc->fmt_ctx, NULL);
+    if (!enc->stream) {
+        fprintf(stderr, "无法创建输出流\n");
+        return -1;
+    }
+    // 复制编码参数到流
+    avcodec_parameters_from_context(enc->stream->codecpar, enc->codec_ctx);
+    enc->stream->time_base = enc->codec_ctx->time_base;
+    // 打开输出文件
+    if (enc->output_dir) {
+        if (segment_writer_open(&enc->seg) != 0) {
+            return -1;
+        }
+        uint8_t* iobuf = av_malloc(SEG_IO_BUFFER);
+        enc->fmt_ctx->pb = iobuf ? avio_alloc_context(iobuf, SEG_IO_BUFFER, 1, &enc->seg,
+                                                      NULL, seg_write_cb, seg_seek_cb) : NULL;
+        if (!enc->fmt_ctx->pb) {
+            av_free(iobuf);
+            fprintf(stderr, "无法创建分段输出\n");
+            return -1;
+        }
+        enc->fmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+        av_dict_set(&opts, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+    } else if (!(enc->fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+        if (avio_open(&enc->fmt_ctx->pb, enc->output_file, AVIO_FLAG_WRITE) < 0) {
+            fprintf(stderr, "无法打开输出文件\n");
+            return -1;
+        }
+    }
+    // 写入文件头
+    int ret = avformat_write_header(enc->fmt_ctx, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        fprintf(stderr, "写入头文件失败\n");
+        return -1;
+    }
+    enc->header_written = 1;
+    if (enc->output_dir && enc->index_interval_ms > 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        // 索引失败不影响录像
+        event_index_create(&enc->index, enc->seg.path,
+                           ts.tv_sec * 1000LL + ts.tv_nsec / 1000000, enc->index_interval_ms);
+        enc->summary_start_ms = 0;
+    }
+    return 0;
+}
+
+// 分段内时间（毫秒）
+static int64_t segment_ms(VideoEncoder* enc, int64_t pts) {
+    return av_rescale_q(pts - enc->seg_first_pts, enc->codec_ctx->time_base, (AVRational){1, 1000});
+}
+
+/*
+* 每个汇总周期把期间的检测结果写入事件索引（无人的周期不写）
+* 与关键帧记录一样按已写入本分段的包的时间戳计时，索引记录保持pts_ms非递减；编码器有延迟时汇总也随之推迟
+* @force: 分段结束时写出不足一个周期的剩余结果
+*/
+static void encoder_flush_summary(VideoEncoder* enc, int64_t pkt_pts, int force) {
+    if (enc->index.fd < 0 || enc->seg_first_pts == AV_NOPTS_VALUE || pkt_pts == AV_NOPTS_VALUE) return;
+    int64_t now_ms = segment_ms(enc, pkt_pts);
+    if (!force && now_ms - enc->summary_start_ms < enc->index_interval_ms) return;
+    pthread_mutex_lock(&enc->det_lock);
+    struct event_summary s = enc->det_summary;
+    memset(&enc->det_summary, 0, sizeof(enc->det_summary));
+    pthread_mutex_unlock(&enc->det_lock);
+
+    if (s.count > 0) {
+        event_index_add_detect(&enc->index, now_ms, (int)(now_ms - enc->summary_start_ms), &s);
+    }
+    enc->summary_start_ms = now_ms;
+}
+
+// 关闭当前输出：写文件尾并释放muxer，分段模式下截掉预分配余量并执行磁盘预算
+static void muxer_close(VideoEncoder* enc) {
+    if (!enc->fmt_ctx) return;
+    if (enc->header_written) {
+        av_write_trailer(enc->fmt_ctx);
+        enc->header_written = 0;
+    }
+    if (enc->output_dir) {
+        encoder_flush_summary(enc, enc->last_mux_pts, 1);  // 本分段剩余的检测汇总写入本分段的索引
+        if (enc->fmt_ctx->pb) {
+            avio_flush(enc->fmt_ctx->pb);
+            av_freep(&enc->fmt_ctx->pb->buffer);
+            avio_context_free(&enc->fmt_ctx->pb);
+        }
+        segment_writer_close(&enc->seg);
+        event_index_close(&enc->index);
+    } else if (!(enc->fmt_ctx->oformat->flags & AVFMT_NOFILE) && enc->fmt_ctx->pb) {
+        avio_closep(&enc->fmt_ctx->pb);
+    }
+    avformat_free_context(enc->fmt_ctx);
+    enc->fmt_ctx = NULL;
+    enc->stream = NULL;
+}
+
+
+/*
+* 根据最新检测结果更新编码档位
+* 有人：目标码率bit_rate，较短的关键帧间隔，人出现时立即插入关键帧，行人区域ROI提升质量
+* 无人：目标码率quiet_bit_rate，较长的关键帧间隔，可按quiet_frame_div降帧
+* @index: 输入帧序号（无人降帧按输入帧抽取；时间戳取自采集时间，跳过的帧不影响录像时间）
+* @return: 1 编码本帧, 0 跳过本帧
+*/
+static int encoder_update_activity(VideoEncoder* enc, int64_t index) {
+    struct det_location roi[ENC_MAX_ROI];
+    int64_t now = monotonic_ns();
+
+    pthread_mutex_lock(&enc->det_lock);
+    int roi_count = enc->roi_count;
+    memcpy(roi, enc->roi, sizeof(roi[0]) * roi_count);
+    int active = enc->last_active_ns &&
+                 now - enc->last_active_ns < (int64_t)enc->active_hold_ms * 1000000LL;
+    pthread_mutex_unlock(&enc->det_lock);
+
+    enc->frame->pict_type = AV_PICTURE_TYPE_NONE;
+    if (active != enc->active) {
+        enc->active = active;
+        enc->active_frames = 0;
+        if (enc->quiet_bit_rate > 0) {
+            // libx264在下一帧时按新的bit_rate重新配置码率控制
+            enc->codec_ctx->bit_rate = active ? enc->bit_rate : enc->quiet_bit_rate;
+            if (active) {
+                enc->frame->pict_type = AV_PICTURE_TYPE_I;
+            }
+            fprintf(stderr, "编码档位切换: %s, 码率%dkbps\n", active ? "有人" : "无人",
+                    (int)(enc->codec_ctx->bit_rate / 1000));
+        }
+    }
+    if (!active && enc->quiet_frame_div > 1 && index % enc->quiet_frame_div != 0) {
+        return 0;
+    }
+    if (active && enc->active_gop > 0 && enc->active_frames > 0 &&
+        enc->active_frames % enc->active_gop == 0) {
+        enc->frame->pict_type = AV_PICTURE_TYPE_I;
+    }
+    enc->active_frames++;
+
+    // ROI：行人区域使用负的量化偏移（libx264要求自适应量化开启，见video_encoder_init）
+    av_frame_remove_side_data(enc->frame, AV_FRAME_DATA_REGIONS_OF_INTEREST);
+    if (enc->roi_qoffset < 0 && roi_count > 0) {
+        AVFrameSideData* sd = av_frame_new_side_data(enc->frame, AV_FRAME_DATA_REGIONS_OF_INTEREST,
+                                                     roi_count * sizeof(AVRegionOfInterest));
+        if (sd) {
+            AVRegionOfInterest* r = (AVRegionOfInterest*)sd->data;
+            for (int i = 0; i < roi_count; i++) {
+                r[i].self_size = sizeof(AVRegionOfInterest);
+                r[i].left = roi[i].x1 - ROI_MARGIN < 0 ? 0 : roi[i].x1 - ROI_MARGIN;
+                r[i].top = roi[i].y1 - ROI_MARGIN < 0 ? 0 : roi[i].y1 - ROI_MARGIN;
+                r[i].right = roi[i].x2 + ROI_MARGIN > enc->width ? enc->width : roi[i].x2 + ROI_MARGIN;
+                r[i].bottom = roi[i].y2 + ROI_MARGIN > enc->height ? enc->height : roi[i].y2 + ROI_MARGIN;
+                r[i].qoffset = av_make_q((int)(enc->roi_qoffset * 100), 100);
+            }
+        }
+    }
+    return 1;
+}
 
 int video_encoder_init(VideoEncoder* enc) {
     // 检查参数有效性
-    if (!enc || !enc->output_file || enc->width <= 0 || enc->height <= 0) {
+    if (!enc || (!enc->output_file && !enc->output_dir && !enc->on_packet) || enc->width <= 0 || enc->height <= 0) {
         return -1;
     }
 
@@ -12,24 +209,35 @@ int video_encoder_init(VideoEncoder* enc) {
     enc->frame = NULL;
     enc->sws_ctx = NULL;
     enc->frame_count = 0;
+    enc->first_capture_ns = 0;
+    enc->last_capture_ns = 0;
+    enc->last_pts = AV_NOPTS_VALUE;
+    memset(enc->span_ns, 0, sizeof(enc->span_ns));
+    enc->encode_ns = 0;
+    enc->encode_max_ns = 0;
     enc->initialized = 0;
-    // 创建输出上下文
-    if (avformat_alloc_output_context2(&enc->fmt_ctx, NULL, NULL, enc->output_file) < 0) {
-        fprintf(stderr, "无法创建输出上下文\n");
-        goto error;
-    }
+    pthread_mutex_init(&enc->det_lock, NULL);
+    enc->roi_count = 0;
+    enc->last_active_ns = 0;
+    enc->active = 0;
+    enc->active_frames = 0;
+    memset(enc->bytes, 0, sizeof(enc->bytes));
+    memset(enc->frames, 0, sizeof(enc->frames));
+    enc->header_written = 0;
+    enc->segment_due = 0;
+    enc->seg.dir = enc->output_dir;
+    enc->seg.prefix = "rec";
+    enc->seg.prealloc_bytes = enc->segment_prealloc;
+    enc->seg.disk_budget = enc->disk_budget;
+    enc->seg.fd = -1;
+    enc->index.fd = -1;
+    memset(&enc->det_summary, 0, sizeof(enc->det_summary));
     // 查找编码器
     AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_H264);
     if (!codec) {
         fprintf(stderr, "找不到H.264编码器\n");
         goto error;
     }
-    // 创建输出流
-    enc->stream = avformat_new_stream(enc->fmt_ctx, NULL);
-    if (!enc->stream) {
-        fprintf(stderr, "无法创建输出流\n");
-        goto error;
-    }
     // 分配编码器上下文
     enc->codec_ctx = avcodec_alloc_context3(codec);
     if (!enc->codec_ctx) {
@@ -41,37 +249,45 @@ int video_encoder_init(VideoEncoder* enc) {
     enc->codec_ctx->width = enc->width; 
     enc->codec_ctx->height = enc->height;
     enc->codec_ctx->pix_fmt = AV_PIX_FMT_NV12; // 设置像素格式
-    enc->codec_ctx->time_base = (AVRational){1, enc->frame_rate}; // 设置时间基准
-    enc->codec_ctx->framerate = (AVRational){enc->frame_rate, 1}; // 设置帧率
-    enc->codec_ctx->bit_rate = enc->bit_rate;     // 设置比特率
+    enc->codec_ctx->time_base = (AVRational){1, ENC_TIME_BASE}; // 设置时间基准（可变帧率，时间戳来自采集时间）
+    enc->codec_ctx->framerate = (AVRational){enc->frame_rate, 1}; // 设置标称帧率
+    enc->codec_ctx->bit_rate = enc->quiet_bit_rate > 0 ? enc->quiet_bit_rate : enc->bit_rate; // 设置比特率（启用码率控制时从无人档位开始）
+    if (enc->quiet_bit_rate > 0) {
+        enc->codec_ctx->gop_size = enc->frame_rate * 10;  // 无人时的长关键帧间隔，有人时按active_gop强制插入关键帧
+    } else if (enc->gop > 0) {
+        enc->codec_ctx->gop_size = enc->gop;
+    }
     enc->codec_ctx->rc_max_rate = enc->max_rate;  // 设置最大比特率
     enc->codec_ctx->rc_buffer_size = enc->max_rate; // 设置缓冲区大小
     enc->codec_ctx->qmin = 5;  // 最低量化参数（值越小质量越高）
     enc->codec_ctx->qmax = 25; // 最高量化参数（值越大质量越低）
+    enc->codec_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER; // SPS/PPS放在extradata中（MP4要求，分段时每段都要写入moov）
     // 必须添加的硬件编码控制参数
     AVDictionary *options = NULL;
     av_dict_set(&options, "preset", "ultrafast", 0);  // 降低CPU消耗
     av_dict_set(&options, "tune", "zerolatency", 0);  // 嵌入式必选
     av_dict_set(&options, "profile", "baseline", 0);  // 兼容性优先
+    if (enc->roi_qoffset < 0) {
+        // ultrafast会关闭自适应量化（aq-mode=0），libx264封装此时丢弃全部ROI附加数据，ROI需要重新打开它
+        av_dict_set(&options, "aq-mode", "1", 0);
+    }
 
-
-    // 打开编码器
-    if (avcodec_open2(enc->codec_ctx, codec, NULL) < 0) {
+    // 打开编码器（无B帧、零延迟：包时间戳与输入顺序一致，实时流和事件索引依赖这一点）
+    // libx264在这里创建编码线程，线程继承调用者的策略：实时主线程先临时切回普通调度、解除绑核
+    thread_policy_suspend();
+    int ret = avcodec_open2(enc->codec_ctx, codec, &options);
+    thread_policy_resume();
+    AVDictionaryEntry* unused = NULL;
+    while ((unused = av_dict_get(options, "", unused, AV_DICT_IGNORE_SUFFIX))) {
+        fprintf(stderr, "编码器未识别的参数(WARN): %s=%s\n", unused->key, unused->value);
+    }
+    av_dict_free(&options);
+    if (ret < 0) {
         fprintf(stderr, "无法打开编码器\n");
         goto error;
     }
-    // 复制编码参数到流
-    avcodec_parameters_from_context(enc->stream->codecpar, enc->codec_ctx);
-    // 打开输出文件
-    if (!(enc->fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
-        if (avio_open(&enc->fmt_ctx->pb, enc->output_file, AVIO_FLAG_WRITE) < 0) {
-            fprintf(stderr, "无法打开输出文件\n");
-            goto error;
-        }
-    }
-    // 写入文件头
-    if (avformat_write_header(enc->fmt_ctx, NULL) < 0) {
-        fprintf(stderr, "写入头文件失败\n");
+    // 打开输出
+    if (muxer_open(enc) != 0) {
         goto error;
     }
     // 分配帧
@@ -90,23 +306,55 @@ int video_encoder_init(VideoEncoder* enc) {
     enc->initialized = 1;
     return 0;
 error:
-    video_encoder_release(enc);
+    video_encoder_release(enc);  // 未初始化完成时release不销毁det_lock
+    pthread_mutex_destroy(&enc->det_lock);
     return -1;
 }
 
-int video_encoder_process(VideoEncoder* enc, uint8_t* cam_data) {
-    if (!enc || !enc->initialized || !cam_data) {
+int video_encoder_process(VideoEncoder* enc, const struct frame_desc* frame) {
+    if (!enc || !enc->initialized || !frame || !frame->base) {
+        return -1;
+    }
+    if (frame->fourcc != FRAME_FMT_NV12 || frame->width != enc->width || frame->height != enc->height) {
+        fprintf(stderr, "编码输入帧格式不匹配: %dx%d\n", frame->width, frame->height);
         return -1;
     }
-    // 直接填充NV12数据（零拷贝优化）
-    enc->frame->data[0] = cam_data;                        // Y平面
-    enc->frame->data[1] = cam_data + enc->width * enc->height;  // UV交错平面
-    enc->frame->linesize[0] = enc->width;
-    enc->frame->linesize[1] = enc->width;
-    
-    // 设置时间戳
-    enc->frame->pts = enc->frame_count++;
+    // 直接引用采集缓冲区（零拷贝），平面位置和行步长按帧描述，带对齐的缓冲区也不需要重排
+    enc->frame->data[0] = frame_plane(frame, 0);      // Y平面
+    enc->frame->data[1] = frame_plane(frame, 1);      // UV交错平面
+    enc->frame->linesize[0] = frame->stride[0];
+    enc->frame->linesize[1] = frame->stride[1];
+    int64_t capture_ns = frame->meta.capture_ns;
+
+    // 设置时间戳：采集时间相对第一帧的偏移，主循环丢帧或延迟时录像时间依然准确
+    if (capture_ns <= 0) {
+        capture_ns = monotonic_ns();
+    }
+    if (enc->frame_count == 0) {
+        enc->first_capture_ns = capture_ns;
+    } else {
+        enc->span_ns[enc->active] += capture_ns - enc->last_capture_ns;
+    }
+    enc->last_capture_ns = capture_ns;
+    int64_t pts = av_rescale_q(capture_ns - enc->first_capture_ns, (AVRational){1, 1000000000},
+                               enc->codec_ctx->time_base);
+    if (!encoder_update_activity(enc, enc->frame_count++)) {
+        return 0;  // 无人降帧
+    }
+    if (enc->last_pts != AV_NOPTS_VALUE && pts <= enc->last_pts) {
+        pts = enc->last_pts + 1;  // 采集时间戳重复或回退（如重新开流）时保持递增
+    }
+    enc->last_pts = pts;
+    enc->frame->pts = pts;
+    enc->frames[enc->active]++;
+    // 分段时长已到：强制关键帧，收到该关键帧时切换到新分段
+    if (enc->output_dir && enc->segment_seconds > 0 && enc->seg_first_pts != AV_NOPTS_VALUE &&
+        segment_ms(enc, pts) >= (int64_t)enc->segment_seconds * 1000) {
+        enc->frame->pict_type = AV_PICTURE_TYPE_I;
+        enc->segment_due = 1;
+    }
     // 编码帧
+    int64_t t0 = monotonic_ns(), t_write = 0;
     int ret = avcodec_send_frame(enc->codec_ctx, enc->frame);
     if (ret < 0) {
         fprintf(stderr, "发送帧到编码器失败: %d\n", ret);
@@ -122,32 +370,114 @@ int video_encoder_process(VideoEncoder* enc, uint8_t* cam_data) {
         } else if (ret < 0) {
             fprintf(stderr, "编码错误: %d\n", ret);
             av_packet_unref(&pkt);
-            break;
+            return -1;  // 交给调用方重建编码器
         }
         
-        // 设置时间戳
-        pkt.pts = av_rescale_q(enc->frame_count - 1, 
-                              enc->codec_ctx->time_base,
-                              enc->stream->time_base);
-        pkt.dts = pkt.pts;
+        // 切换分段
+        if (enc->segment_due && (pkt.flags & AV_PKT_FLAG_KEY)) {
+            enc->segment_due = 0;
+            muxer_close(enc);
+            if (muxer_open(enc) != 0) {
+                fprintf(stderr, "新分段创建失败\n");
+                av_packet_unref(&pkt);
+                return -1;
+            }
+        }
+        int64_t pkt_pts = pkt.pts;
+        if (enc->seg_first_pts == AV_NOPTS_VALUE) {
+            enc->seg_first_pts = pkt_pts;
+        }
+
+        // 设置时间戳（分段内从0开始，编码器时间基 -> 流时间基）
+        AVRational tb = enc->stream ? enc->stream->time_base : enc->codec_ctx->time_base;
+        pkt.pts = av_rescale_q(pkt_pts - enc->seg_first_pts, enc->codec_ctx->time_base, tb);
+        pkt.dts = pkt.dts == AV_NOPTS_VALUE ? pkt.pts :
+                  av_rescale_q(pkt.dts - enc->seg_first_pts, enc->codec_ctx->time_base, tb);
+        pkt.duration = 0;  // 可变帧率：时长由下一帧时间戳决定
+        enc->bytes[enc->active] += pkt.size;
+
+        // 分发给实时流等（共享同一份数据，不重复编码）
+        if (enc->on_packet) {
+            enc->on_packet(enc->on_packet_opaque, &pkt);
+        }
 
+        if (!enc->fmt_ctx) {
+            av_packet_unref(&pkt);
+            continue;
+        }
         // 写入文件
-        if (av_interleaved_write_frame(enc->fmt_ctx, &pkt) < 0) {
-            fprintf(stderr, "写入帧失败\n");
+        int64_t tw = monotonic_ns();
+        ret = av_interleaved_write_frame(enc->fmt_ctx, &pkt);
+        if (ret < 0) {
+            fprintf(stderr, "写入帧失败: %d\n", ret);  // 磁盘满、EIO等：录像已中断，不能当作成功
             av_packet_unref(&pkt);
-            break;
+            return -1;
         }
+        // 关键帧意味着上一个分片已经写出，提交回写；
+        // 此时的写入位置就是这个关键帧所在分片的起点，记入索引供剪辑定位
+        if (enc->output_dir && (pkt.flags & AV_PKT_FLAG_KEY)) {
+            avio_flush(enc->fmt_ctx->pb);
+            segment_writer_sync(&enc->seg);
+            event_index_add_keyframe(&enc->index, segment_ms(enc, pkt_pts), avio_tell(enc->fmt_ctx->pb));
+        }
+        enc->last_mux_pts = pkt_pts;
+        encoder_flush_summary(enc, pkt_pts, 0);
+        t_write += monotonic_ns() - tw;
         av_packet_unref(&pkt);
     }
+    int64_t cost = monotonic_ns() - t0 - t_write;
+    enc->encode_ns += cost;
+    if (cost > enc->encode_max_ns) enc->encode_max_ns = cost;
     return 0;
 }
 
+void video_encoder_update_detections(VideoEncoder* enc, const struct all_det_location* all_loc) {
+    if (!enc || !enc->initialized) return;
+    pthread_mutex_lock(&enc->det_lock);
+    int n = all_loc ? all_loc->count : 0;
+    if (n > ENC_MAX_ROI) n = ENC_MAX_ROI;
+    for (int i = 0; i < n; i++) {
+        enc->roi[i] = *all_loc->locations[i];
+    }
+    enc->roi_count = n;
+    if (n > 0) {
+        enc->last_active_ns = monotonic_ns();
+        if (n > enc->det_summary.count) enc->det_summary.count = n;
+        for (int i = 0; i < n; i++) {
+            event_summary_add(&enc->det_summary, enc->roi[i].x1, enc->roi[i].y1,
+                              enc->roi[i].x2, enc->roi[i].y2, enc->roi[i].score);
+        }
+    }
+    pthread_mutex_unlock(&enc->det_lock);
+}
+
+// 打印各档位的平均码率和编码耗时
+static void encoder_report(VideoEncoder* enc) {
+    static const char* names[2] = { "无人", "有人" };
+    const char* name = enc->name ? enc->name : "";
+    for (int i = 0; i < 2; i++) {
+        if (enc->frames[i] == 0 || enc->span_ns[i] <= 0) continue;
+        double seconds = enc->span_ns[i] / 1e9;
+        fprintf(stderr, "编码统计%s %s: %llu帧 %.1f秒 平均%.1f帧/秒 %.1fkbps\n", name, names[i],
+                (unsigned long long)enc->frames[i], seconds, enc->frames[i] / seconds,
+                enc->bytes[i] * 8 / seconds / 1000);
+    }
+    uint64_t frames = enc->frames[0] + enc->frames[1];
+    if (frames > 0) {
+        fprintf(stderr, "编码耗时%s %dx%d: 平均%.2fms 最大%.2fms\n", name, enc->width, enc->height,
+                enc->encode_ns / 1e6 / frames, enc->encode_max_ns / 1e6);
+    }
+}
+
 void video_encoder_release(VideoEncoder* enc) {
     if (!enc) return;
-    // 写入文件尾
-    if (enc->fmt_ctx && enc->initialized) {
-        av_write_trailer(enc->fmt_ctx);
+    // det_lock只随一次成功的初始化销毁一次：重建失败或停用子码流后再次release时不能重复销毁
+    int was_initialized = enc->initialized;
+    if (was_initialized) {
+        encoder_report(enc);
     }
+    // 写入文件尾并关闭输出
+    muxer_close(enc);
     // 释放资源
     if (enc->sws_ctx) {
         sws_freeContext(enc->sws_ctx);
@@ -161,13 +491,9 @@ void video_encoder_release(VideoEncoder* enc) {
         avcodec_free_context(&enc->codec_ctx);
         enc->codec_ctx = NULL;
     }
-    if (enc->fmt_ctx) {
-        if (!(enc->fmt_ctx->oformat->flags & AVFMT_NOFILE) && enc->fmt_ctx->pb) {
-            avio_closep(&enc->fmt_ctx->pb);
-        }
-        avformat_free_context(enc->fmt_ctx);
-        enc->fmt_ctx = NULL;
-    }
     enc->initialized = 0;
+    if (was_initialized) {
+        pthread_mutex_destroy(&enc->det_lock);
+    }
     fprintf(stderr, "视频编码器资源已释放\n");
 }
\ No newline at end of file
@@ -0,0 +1,158 @@
+#define _GNU_SOURCE
+#include "common.h"
+#include "segment_writer.h"
+#include "event_index.h"
+#include <dirent.h>
+
+#define SEGMENT_SUFFIX ".mp4"
+#define MAX_SEGMENTS 4096   // 预算检查时最多统计的分段数
+#define MAX_NAME_RETRY 99   // 同一秒内（编码器重建、时钟回调）重名时追加的序号上限
+
+/*
+* 新建分段文件
+* 1. 按当前时间生成文件名，已存在时追加_01、_02…（O_EXCL创建，绝不覆盖已有分段）
+* 2. fallocate预分配空间（FALLOC_FL_KEEP_SIZE：文件大小仍随写入增长，掉电后不会出现一段全零的尾部）
+* @return: 0 成功, -1 失败
+*/
+int segment_writer_open(struct segment_writer* sw) {
+    mkdir(sw->dir, 0755);
+    segment_writer_enforce_quota(sw);  // 先腾出新分段的空间
+
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char base[224];
+    snprintf(base, sizeof(base), "%s/%s_%04d%02d%02d_%02d%02d%02d",
+             sw->dir, sw->prefix, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec);
+
+    // 序号两位补零：按名字排序时仍按创建顺序（"."排在"_"之前，无序号的最早）
+    sw->fd = -1;
+    for (int n = 0; n <= MAX_NAME_RETRY && sw->fd < 0; n++) {
+        if (n == 0) {
+            snprintf(sw->path, sizeof(sw->path), "%s" SEGMENT_SUFFIX, base);
+        } else {
+            snprintf(sw->path, sizeof(sw->path), "%s_%02d" SEGMENT_SUFFIX, base, n);
+        }
+        sw->fd = open(sw->path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (sw->fd < 0 && errno != EEXIST) break;
+    }
+    if (sw->fd < 0) {
+        fprintf(stderr, "无法创建分段文件%s: %s\n", sw->path, strerror(errno));
+        return -1;
+    }
+    if (sw->prealloc_bytes > 0 &&
+        fallocate(sw->fd, FALLOC_FL_KEEP_SIZE, 0, sw->prealloc_bytes) != 0) {
+        fprintf(stderr, "分段预分配失败(WARN): %s\n", strerror(errno));  // 文件系统不支持时照常写入
+    }
+    sw->pos = 0;
+    sw->size = 0;
+    sw->synced = 0;
+    fprintf(stderr, "新录像分段: %s\n", sw->path);
+    return 0;
+}
+
+int segment_writer_write(struct segment_writer* sw, const uint8_t* buf, int len) {
+    int done = 0;
+    while (done < len) {
+        ssize_t n = pwrite(sw->fd, buf + done, len - done, sw->pos);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "分段写入失败: %s\n", strerror(errno));
+            return -1;
+        }
+        done += n;
+        sw->pos += n;
+    }
+    if (sw->pos > sw->size) sw->size = sw->pos;
+    return done;
+}
+
+int64_t segment_writer_seek(struct segment_writer* sw, int64_t offset, int whence) {
+    switch (whence) {
+        case SEEK_SET: sw->pos = offset; break;
+        case SEEK_CUR: sw->pos += offset; break;
+        case SEEK_END: sw->pos = sw->size + offset; break;
+        default: return -1;
+    }
+    return sw->pos;
+}
+
+// 只提交回写不等待完成：数据持续小批量落盘，避免脏页积累后集中刷写
+void segment_writer_sync(struct segment_writer* sw) {
+    if (sw->fd < 0 || sw->size <= sw->synced) return;
+    sync_file_range(sw->fd, sw->synced, sw->size - sw->synced, SYNC_FILE_RANGE_WRITE);
+    sw->synced = sw->size;
+}
+
+void segment_writer_close(struct segment_writer* sw) {
+    if (sw->fd < 0) return;
+    if (ftruncate(sw->fd, sw->size) != 0) {  // 释放未用完的预分配空间
+        perror("分段截断失败(WARN)");
+    }
+    fdatasync(sw->fd);
+    close(sw->fd);
+    sw->fd = -1;
+    fprintf(stderr, "录像分段完成: %s (%lld bytes)\n", sw->path, (long long)sw->size);
+    segment_writer_enforce_quota(sw);
+}
+
+struct segment_entry {
+    char name[128];
+    uint64_t bytes;   // 实际占用的磁盘空间（包含预分配）
+};
+
+static int segment_entry_cmp(const void* a, const void* b) {
+    return strcmp(((const struct segment_entry*)a)->name, ((const struct segment_entry*)b)->name);
+}
+
+/*
+* 磁盘预算
+* 文件名带时间，按名字排序即按时间排序；从最旧的开始删除，直到 总占用 + 一个分段的预分配 <= 预算
+* 正在写入的分段不会被删除
+*/
+void segment_writer_enforce_quota(struct segment_writer* sw) {
+    if (sw->disk_budget == 0) return;
+    DIR* dir = opendir(sw->dir);
+    if (!dir) return;
+
+    struct segment_entry* entries = calloc(MAX_SEGMENTS, sizeof(struct segment_entry));
+    if (!entries) {
+        closedir(dir);
+        return;
+    }
+    size_t prefix_len = strlen(sw->prefix);
+    size_t suffix_len = strlen(SEGMENT_SUFFIX);
+    int count = 0;
+    uint64_t total = 0;
+    struct dirent* de;
+    while ((de = readdir(dir)) != NULL && count < MAX_SEGMENTS) {
+        size_t len = strlen(de->d_name);
+        if (len >= sizeof(entries[0].name) || len <= prefix_len + suffix_len ||
+            strncmp(de->d_name, sw->prefix, prefix_len) != 0 ||
+            strcmp(de->d_name + len - suffix_len, SEGMENT_SUFFIX) != 0) {
+            continue;
+        }
+        struct stat st;
+        if (fstatat(dirfd(dir), de->d_name, &st, 0) != 0) continue;
+        strcpy(entries[count].name, de->d_name);
+        entries[count].bytes = (uint64_t)st.st_blocks * 512;
+        total += entries[count].bytes;
+        count++;
+    }
+    qsort(entries, count, sizeof(entries[0]), segment_entry_cmp);
+
+    const char* current = (sw->fd >= 0) ? strrchr(sw->path, '/') : NULL;
+    for (int i = 0; i < count && total + sw->prealloc_bytes > sw->disk_budget; i++) {
+        if (current && strcmp(entries[i].name, current + 1) == 0) continue;
+        if (unlinkat(dirfd(dir), entries[i].name, 0) == 0) {
+            total -= entries[i].bytes;
+            char index_name[sizeof(entries[i].name)];
+            event_index_path(index_name, sizeof(index_name), entries[i].name);
+            unlinkat(dirfd(dir), index_name, 0);  // 同名事件索引（可能不存在）
+            fprintf(stderr, "超出磁盘预算，删除旧分段: %s\n", entries[i].name);
+        }
+    }
+    free(entries);
+    closedir(dir);
+}
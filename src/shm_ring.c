@@ -0,0 +1,268 @@
+#include "shm_ring.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <signal.h>
+
+// 序号锁使用GCC原子内建（头文件同时被C++编译单元包含，不使用stdatomic）
+#define LOAD_ACQ(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_REL(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static struct shm_frame_slot* frame_slot(const struct shm_ring_header* h, uint64_t id) {
+    return (struct shm_frame_slot*)((uint8_t*)h + h->frame_offset + (id % h->frame_slots) * h->frame_stride);
+}
+
+static struct shm_det_slot* det_slot(const struct shm_ring_header* h, uint64_t id) {
+    return (struct shm_det_slot*)((uint8_t*)h + h->det_offset) + id % h->det_slots;
+}
+
+static uint8_t* frame_data(struct shm_frame_slot* slot) {
+    return (uint8_t*)slot + SHM_SLOT_ALIGN;
+}
+
+// 写者：开始写第id个（锁置为奇数，读者看到后放弃该槽）
+static void seq_write_begin(uint64_t* lock, uint64_t id) {
+    __atomic_store_n(lock, id * 2 - 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/*
+* 检查同名共享内存的生产者是否还在运行
+* 只读打开已有对象的头部：magic正确且producer_pid对应的进程仍存在时认为正在使用；
+* 没有magic（上次初始化到一半就退出）或进程已不存在时是遗留的，可以删除
+* @return: 1 正在使用, 0 不存在或已遗留
+*/
+static int shm_ring_in_use(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat st;
+    int in_use = 0;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(struct shm_ring_header)) {
+        void* map = mmap(NULL, sizeof(struct shm_ring_header), PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            const struct shm_ring_header* h = (const struct shm_ring_header*)map;
+            pid_t pid = (pid_t)h->producer_pid;
+            if (memcmp(h->magic, SHM_RING_MAGIC, sizeof(h->magic)) == 0 && pid > 0 &&
+                (kill(pid, 0) == 0 || errno == EPERM)) {
+                fprintf(stderr, "共享内存%s正由进程%d使用\n", name, (int)pid);
+                in_use = 1;
+            }
+            munmap(map, sizeof(struct shm_ring_header));
+        }
+    }
+    close(fd);
+    return in_use;
+}
+
+/*
+* 创建共享内存环
+* @name: 共享内存名（如"/k230_pipeline"），读者用同一个名字打开
+* @return: 0 成功, -1 失败
+*/
+int shm_ring_create(struct shm_ring* ring, const char* name, int width, int height,
+                    int frame_slots, int det_slots) {
+    memset(ring, 0, sizeof(*ring));
+    snprintf(ring->name, sizeof(ring->name), "%s", name);
+    size_t frame_size = (size_t)width * height * 3 / 2;
+    size_t frame_stride = SHM_SLOT_ALIGN + (frame_size + SHM_SLOT_ALIGN - 1) / SHM_SLOT_ALIGN * SHM_SLOT_ALIGN;
+    size_t det_offset = SHM_SLOT_ALIGN + frame_stride * frame_slots;
+    size_t total = det_offset + sizeof(struct shm_det_slot) * det_slots;
+
+    // 上次异常退出时遗留的才删除；生产者还在运行（第二个实例、或旧进程未退出）时不能把它的共享内存删掉
+    if (shm_ring_in_use(name)) {
+        return -1;
+    }
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "无法创建共享内存%s: %s\n", name, strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, total) != 0) {
+        perror("共享内存大小设置失败");
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    void* map = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("共享内存映射失败");
+        shm_unlink(name);
+        return -1;
+    }
+    ring->map = map;
+    ring->map_size = total;
+    ring->header = (struct shm_ring_header*)map;
+
+    struct shm_ring_header* h = ring->header;   // ftruncate后内容全零，锁和head都从0开始
+    h->version = SHM_RING_VERSION;
+    h->producer_pid = getpid();
+    h->width = width;
+    h->height = height;
+    h->frame_size = frame_size;
+    h->frame_slots = frame_slots;
+    h->frame_offset = SHM_SLOT_ALIGN;
+    h->frame_stride = frame_stride;
+    h->det_slots = det_slots;
+    h->det_max = SHM_DET_MAX;
+    h->det_offset = det_offset;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(h->magic, SHM_RING_MAGIC, sizeof(h->magic));  // 读者看到magic时其余字段已就绪
+    fprintf(stderr, "共享内存发布: /dev/shm%s (%d帧槽, %.1fMB)\n", name, frame_slots, total / 1048576.0);
+    return 0;
+}
+
+// 发布一帧：按帧描述拷贝到下一个帧槽，槽内始终是紧凑排列的NV12（只由采集线程调用）
+void shm_ring_publish_frame(struct shm_ring* ring, const struct frame_desc* frame) {
+    if (!ring->header) return;
+    struct shm_ring_header* h = ring->header;
+    uint64_t id = h->frame_head + 1;
+    struct shm_frame_slot* slot = frame_slot(h, id);
+    if (frame->width != (int)h->width || frame->height != (int)h->height) return;
+    seq_write_begin(&slot->lock, id);
+    slot->sequence = frame->meta.sequence;
+    slot->capture_ns = frame->meta.capture_ns;
+    if (frame_desc_is_packed(frame)) {
+        memcpy(frame_data(slot), frame->base, h->frame_size);
+    } else {
+        // 带行对齐的缓冲区逐行拷贝（不依赖nv12.c，读者工具只链接本文件）
+        uint8_t* dst = frame_data(slot);
+        for (int p = 0; p < 2; p++) {
+            const uint8_t* src = frame_plane(frame, p);
+            int rows = p == 0 ? frame->height : frame->height / 2;
+            for (int j = 0; j < rows; j++, dst += frame->width) {
+                memcpy(dst, src + (size_t)j * frame->stride[p], frame->width);
+            }
+        }
+    }
+    STORE_REL(&slot->lock, id * 2);
+    STORE_REL(&h->frame_head, id);
+    ring->published++;
+}
+
+// 发布一次检测结果（只由检测线程调用）
+void shm_ring_publish_detections(struct shm_ring* ring, const struct all_det_location* all_loc,
+                                 uint32_t sequence, int64_t capture_ns) {
+    if (!ring->header) return;
+    struct shm_ring_header* h = ring->header;
+    uint64_t id = h->det_head + 1;
+    struct shm_det_slot* slot = det_slot(h, id);
+    int n = all_loc ? all_loc->count : 0;
+    if (n > SHM_DET_MAX) n = SHM_DET_MAX;
+    seq_write_begin(&slot->lock, id);
+    slot->sequence = sequence;
+    slot->capture_ns = capture_ns;
+    slot->count = n;
+    for (int i = 0; i < n; i++) {
+        slot->boxes[i] = *all_loc->locations[i];
+    }
+    STORE_REL(&slot->lock, id * 2);
+    STORE_REL(&h->det_head, id);
+}
+
+void shm_ring_destroy(struct shm_ring* ring) {
+    if (!ring->map) return;
+    munmap(ring->map, ring->map_size);
+    shm_unlink(ring->name);
+    fprintf(stderr, "共享内存已删除: 共发布%llu帧\n", (unsigned long long)ring->published);
+    memset(ring, 0, sizeof(*ring));
+}
+
+/*
+* 打开共享内存（只读）
+* @return: 0 成功, -1 失败（流水线未运行或版本不符）
+*/
+int shm_reader_open(struct shm_reader* rd, const char* name) {
+    memset(rd, 0, sizeof(*rd));
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "无法打开共享内存%s: %s\n", name, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(struct shm_ring_header)) {
+        close(fd);
+        return -1;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("共享内存映射失败");
+        return -1;
+    }
+    const struct shm_ring_header* h = (const struct shm_ring_header*)map;
+    if (memcmp(h->magic, SHM_RING_MAGIC, sizeof(h->magic)) != 0 || h->version != SHM_RING_VERSION) {
+        fprintf(stderr, "共享内存%s格式不符\n", name);
+        munmap(map, st.st_size);
+        return -1;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    rd->map = map;
+    rd->map_size = st.st_size;
+    rd->header = h;
+    rd->last_frame = LOAD_ACQ(&h->frame_head);   // 从打开之后发布的帧开始
+    rd->last_det = 0;
+    return 0;
+}
+
+void shm_reader_close(struct shm_reader* rd) {
+    if (rd->map) {
+        munmap(rd->map, rd->map_size);
+    }
+    memset(rd, 0, sizeof(*rd));
+}
+
+bool shm_reader_next_frame(struct shm_reader* rd, struct shm_frame_view* view) {
+    const struct shm_ring_header* h = rd->header;
+    uint64_t head = LOAD_ACQ(&h->frame_head);
+    if (head <= rd->last_frame) return false;
+    uint64_t id = rd->last_frame + 1;
+    // 写者会覆盖head之后的第一个槽，至少留一个槽的余量，否则直接跳到最新
+    if (head - id + 2 > h->frame_slots) {
+        rd->skipped += head - id;
+        id = head;
+    }
+    struct shm_frame_slot* slot = frame_slot(h, id);
+    if (LOAD_ACQ(&slot->lock) != id * 2) {   // 已被覆盖
+        rd->skipped++;
+        rd->last_frame = id;
+        return false;
+    }
+    view->id = id;
+    view->sequence = slot->sequence;
+    view->capture_ns = slot->capture_ns;
+    view->nv12 = frame_data(slot);
+    rd->last_frame = id;
+    return shm_reader_frame_valid(rd, view);   // 元数据读完后确认没有被改写
+}
+
+bool shm_reader_frame_valid(struct shm_reader* rd, const struct shm_frame_view* view) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    struct shm_frame_slot* slot = frame_slot(rd->header, view->id);
+    if (__atomic_load_n(&slot->lock, __ATOMIC_RELAXED) != view->id * 2) {
+        rd->torn++;
+        return false;
+    }
+    return true;
+}
+
+bool shm_reader_latest_detections(struct shm_reader* rd, struct shm_det_slot* out) {
+    const struct shm_ring_header* h = rd->header;
+    uint64_t head = LOAD_ACQ(&h->det_head);
+    if (head == 0 || head == rd->last_det) return false;
+    struct shm_det_slot* slot = det_slot(h, head);
+    uint64_t lock = LOAD_ACQ(&slot->lock);
+    if (lock != head * 2) return false;   // 正在被下一次结果覆盖，下次再取
+    memcpy(out, slot, sizeof(*out));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->lock, __ATOMIC_RELAXED) != lock) return false;
+    rd->last_det = head;
+    return true;
+}
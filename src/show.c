@@ -107,7 +107,7 @@ void mydisplay_destroy(struct mydisplay* mydis) {
         display_free_buffer(mydis->box_buf);  // 释放方框缓冲区
         mydis->box_buf = NULL;  // 清空指针
         display_free_plane(mydis->box_plane);  // 释放显示平面
-        mydis->box_buf = NULL;  // 清空指针
+        mydis->box_plane = NULL;  // 清空指针（重建显示时会再次调用本函数）
         fprintf(stderr, "方框平面已释放\n");
     }    
     if (mydis->plane) {
@@ -148,14 +148,23 @@ void draw_box(struct mydisplay *mydis, struct all_det_location* all_loc)
     for( int i = 0; i < all_loc->count; i++) {
         struct det_location* loc = all_loc->locations[i];
         draw_one_box(mydis, loc->x1, loc->y1, loc->x2, loc->y2);
-        // 释放内存
-        free(loc);  // 释放每个检测结果的内存
     }
-    free(all_loc);
+    free_det_location(all_loc);  // 释放检测结果的内存
     // 提交显示
     display_commit_buffer(mydis->box_buf, 0, 0); 
 }
 
+// 用显示坐标的框重画整个叠加层（ePTZ取景框移动时由主线程调用）
+void draw_boxes(struct mydisplay *mydis, const struct det_location* boxes, int count)
+{
+    if(!mydis->box_buf) return;
+    memset(mydis->box_buf->map, 0x00000000, mydis->box_buf->size);
+    for (int i = 0; i < count; i++) {
+        draw_one_box(mydis, boxes[i].x1, boxes[i].y1, boxes[i].x2, boxes[i].y2);
+    }
+    display_commit_buffer(mydis->box_buf, 0, 0);
+}
+
 /**
  * 简易版方框绘制（K230适用）
  * @param mydis  显示控制结构体
@@ -205,6 +214,22 @@ void clear_box(struct mydisplay *mydis)
     display_commit_buffer(mydis->box_buf, 0, 0); 
 }
 
+/*
+* 显示缓冲区的帧描述：按缓冲区报告的stride访问（DRM缓冲区的行通常有对齐），UV平面在stride * height处
+* 旋转平面的缓冲区按硬件尺寸分配，stride小于图像宽度时按紧凑排列处理
+*/
+void mydisplay_frame(struct mydisplay *mydis, int index, struct frame_desc *frame)
+{
+    struct display_buffer* buf = mydis->disp_buf[index];
+    uint32_t stride = buf->stride;
+    if (stride < (uint32_t)mydis->width || buf->size < (size_t)stride * mydis->height * 3 / 2) {
+        stride = mydis->width;
+    }
+    *frame = frame_desc_nv12((uint8_t*)buf->map, mydis->width, mydis->height, stride, stride * mydis->height);
+    frame->size = buf->size;
+    frame->handle = index;
+}
+
 /*
 * 软件帧处理函数
 * 输入 NV12 格式的帧数据，输出处理后的帧数据
@@ -212,15 +237,15 @@ void clear_box(struct mydisplay *mydis)
 */
 
 void process_frame_nv12(
-    uint8_t* nv12_frame,  // 输入 NV12 帧地址 (Y 平面 + UV 交织平面)
-    int width,            // 帧宽 (需为偶数)
-    int height,           // 帧高 (需为偶数)
+    const struct frame_desc* src, // 输入 NV12 帧 (Y 平面 + UV 交织平面，按帧描述的行步长访问)
     uint8_t* out_buffer,  // 输出缓冲区 (转换后的 NV12 帧)
     int screen_width,     // 屏幕宽 (需为偶数)
     int screen_height,    // 屏幕高 (需为偶数)
     int rotation          // 旋转角度 (0, 90, 180, 270)
 ) {
     // 1. 参数检查和强制偶数对齐
+    int width = src->width;
+    int height = src->height;
     if (width <= 0 || height <= 0 || screen_width <= 0 || screen_height <= 0) 
         return;
     
@@ -254,8 +279,10 @@ void process_frame_nv12(
     start_y &= ~1;
 
     // 6. 获取输入帧的 Y 和 UV 平面指针
-    uint8_t* y_plane = nv12_frame;
-    uint8_t* uv_plane = nv12_frame + width * height;
+    const uint8_t* y_plane = frame_plane(src, 0);
+    const uint8_t* uv_plane = frame_plane(src, 1);
+    const int y_stride = src->stride[0];
+    const int uv_stride = src->stride[1];
 
     // 7. 获取输出帧的 Y 和 UV 平面指针
     uint8_t* out_y = out_buffer;
@@ -301,13 +328,13 @@ void process_frame_nv12(
             int out_y_pos = start_y + dy;
 
             // 复制 Y 分量
-            out_y[out_y_pos * screen_width + out_x] = y_plane[y_orig * width + x_orig];
+            out_y[out_y_pos * screen_width + out_x] = y_plane[y_orig * y_stride + x_orig];
 
             // 修改点2：确保所有UV分量都被正确处理
             if ((dx % 2 == 0) && (dy % 2 == 0)) {
                 int uv_x = x_orig / 2;
                 int uv_y = y_orig / 2;
-                int uv_offset = uv_y * width + 2 * uv_x;
+                int uv_offset = uv_y * uv_stride + 2 * uv_x;
                 int out_uv_offset = (out_y_pos / 2) * screen_width + (out_x & ~1);
                 out_uv[out_uv_offset] = uv_plane[uv_offset];      // U
                 out_uv[out_uv_offset + 1] = uv_plane[uv_offset + 1]; // V
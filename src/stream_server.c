@@ -0,0 +1,282 @@
+#include "stream_server.h"
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+static const char http_header[] =
+    "HTTP/1.0 200 OK\r\n"
+    "Content-Type: video/h264\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+static void client_reset(struct stream_client* c) {
+    if (c->fd >= 0) {
+        close(c->fd);
+    }
+    for (unsigned int i = 0; i < c->count; i++) {
+        av_packet_free(&c->queue[(c->head + i) % STREAM_CLIENT_QUEUE]);
+    }
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+}
+
+static void client_drop_all(struct stream_client* c) {
+    // 队首包可能已发出一部分，保留它保证码流边界完整
+    unsigned int keep = (c->offset > 0 && c->count > 0) ? 1 : 0;
+    for (unsigned int i = keep; i < c->count; i++) {
+        av_packet_free(&c->queue[(c->head + i) % STREAM_CLIENT_QUEUE]);
+        c->dropped++;
+    }
+    c->count = keep;
+}
+
+static void accept_client(struct stream_server* srv) {
+    int fd = accept(srv->listen_fd, NULL, NULL);
+    if (fd < 0) return;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    pthread_mutex_lock(&srv->lock);
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        struct stream_client* c = &srv->clients[i];
+        if (c->fd < 0) {
+            c->fd = fd;
+            c->waiting_key = true;
+            pthread_mutex_unlock(&srv->lock);
+            fprintf(stderr, "实时流客户端%d已连接\n", i);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&srv->lock);
+    fprintf(stderr, "实时流客户端已满，拒绝连接\n");
+    close(fd);
+}
+
+// 读取HTTP请求，读到空行后准备响应头和SPS/PPS（调用时已加锁）
+static void client_read_request(struct stream_server* srv, struct stream_client* c) {
+    ssize_t n = recv(c->fd, c->req + c->req_len, sizeof(c->req) - 1 - c->req_len, 0);
+    if (n <= 0) {
+        if (n == 0 || (errno != EAGAIN && errno != EINTR)) client_reset(c);
+        return;
+    }
+    c->req_len += n;
+    c->req[c->req_len] = '\0';
+    if (!strstr(c->req, "\r\n\r\n")) {
+        if (c->req_len >= sizeof(c->req) - 1) client_reset(c);  // 请求过长
+        return;
+    }
+    memcpy(c->prefix, http_header, sizeof(http_header) - 1);
+    c->prefix_len = sizeof(http_header) - 1;
+    memcpy(c->prefix + c->prefix_len, srv->extradata, srv->extradata_size);
+    c->prefix_len += srv->extradata_size;
+    c->prefix_off = 0;
+    c->streaming = true;
+}
+
+// 非阻塞发送，发不完下次继续（调用时已加锁）
+static void client_send(struct stream_client* c) {
+    while (c->prefix_off < c->prefix_len) {
+        ssize_t n = send(c->fd, c->prefix + c->prefix_off, c->prefix_len - c->prefix_off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EINTR) client_reset(c);
+            return;
+        }
+        c->prefix_off += n;
+    }
+    while (c->count > 0) {
+        AVPacket* pkt = c->queue[c->head];
+        ssize_t n = send(c->fd, pkt->data + c->offset, pkt->size - c->offset, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EINTR) client_reset(c);
+            return;
+        }
+        c->offset += n;
+        if (c->offset < (size_t)pkt->size) return;
+        av_packet_free(&c->queue[c->head]);
+        c->head = (c->head + 1) % STREAM_CLIENT_QUEUE;
+        c->count--;
+        c->offset = 0;
+        c->sent++;
+    }
+}
+
+static void* stream_server_thread(void* arg) {
+    struct stream_server* srv = (struct stream_server*)arg;
+    thread_policy_apply(ROLE_WRITER);
+    struct pollfd pfds[STREAM_MAX_CLIENTS + 2];
+    int slot[STREAM_MAX_CLIENTS + 2];
+
+    while (1) {
+        int n = 0;
+        pfds[n].fd = srv->listen_fd; pfds[n].events = POLLIN; slot[n++] = -1;
+        pfds[n].fd = srv->wake_fd;   pfds[n].events = POLLIN; slot[n++] = -1;
+        pthread_mutex_lock(&srv->lock);
+        if (!srv->running) {
+            pthread_mutex_unlock(&srv->lock);
+            break;
+        }
+        for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+            struct stream_client* c = &srv->clients[i];
+            if (c->fd < 0) continue;
+            pfds[n].fd = c->fd;
+            pfds[n].events = c->streaming ? 0 : POLLIN;
+            if (c->streaming && (c->prefix_off < c->prefix_len || c->count > 0)) {
+                pfds[n].events |= POLLOUT;
+            }
+            slot[n++] = i;
+        }
+        pthread_mutex_unlock(&srv->lock);
+
+        if (poll(pfds, n, 1000) < 0) {
+            if (errno == EINTR) continue;
+            perror("实时流poll失败");
+            break;
+        }
+        if (pfds[0].revents & POLLIN) {
+            accept_client(srv);
+        }
+        if (pfds[1].revents & POLLIN) {
+            uint64_t v;
+            if (read(srv->wake_fd, &v, sizeof(v)) < 0) { /* 计数已清零即可 */ }
+        }
+        pthread_mutex_lock(&srv->lock);
+        for (int k = 2; k < n; k++) {
+            struct stream_client* c = &srv->clients[slot[k]];
+            if (c->fd != pfds[k].fd) continue;   // 期间已断开
+            if (pfds[k].revents & (POLLERR | POLLHUP)) {
+                fprintf(stderr, "实时流客户端%d断开（已发送%llu包，丢弃%llu包）\n", slot[k],
+                        (unsigned long long)c->sent, (unsigned long long)c->dropped);
+                client_reset(c);
+            } else if (!c->streaming && (pfds[k].revents & POLLIN)) {
+                client_read_request(srv, c);
+            } else if (c->streaming) {
+                client_send(c);   // 新包到达时也尝试直接发送
+            }
+        }
+        pthread_mutex_unlock(&srv->lock);
+    }
+    thread_policy_exit();
+    return NULL;
+}
+
+/*
+* 启动实时流服务
+* @port: 监听端口（所有网卡），客户端: ffplay http://<板子IP>:<port>/ 或 curl -o live.h264
+* @return: 0 成功, -1 失败
+*/
+int stream_server_start(struct stream_server* srv, int port) {
+    memset(srv, 0, sizeof(*srv));
+    srv->port = port;
+    srv->listen_fd = srv->wake_fd = -1;
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        srv->clients[i].fd = -1;
+    }
+
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (srv->listen_fd < 0) {
+        perror("实时流socket创建失败");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    CLEAR(addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(srv->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(srv->listen_fd, 4) < 0) {
+        perror("实时流端口监听失败");
+        goto error;
+    }
+    srv->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (srv->wake_fd < 0) {
+        perror("eventfd创建失败");
+        goto error;
+    }
+    pthread_mutex_init(&srv->lock, NULL);
+    srv->running = true;
+    if (pthread_create(&srv->thread, NULL, stream_server_thread, srv)) {
+        fprintf(stderr, "无法创建实时流线程\n");
+        srv->running = false;
+        pthread_mutex_destroy(&srv->lock);
+        goto error;
+    }
+    fprintf(stderr, "实时流服务已启动: http://0.0.0.0:%d/\n", port);
+    return 0;
+error:
+    if (srv->wake_fd >= 0) close(srv->wake_fd);
+    close(srv->listen_fd);
+    srv->listen_fd = srv->wake_fd = -1;
+    return -1;
+}
+
+void stream_server_set_extradata(struct stream_server* srv, const uint8_t* data, int size) {
+    if (!srv->running || !data || size <= 0) return;
+    if (size > (int)sizeof(srv->extradata)) {
+        fprintf(stderr, "SPS/PPS过长(%d)，实时流不发送\n", size);
+        return;
+    }
+    pthread_mutex_lock(&srv->lock);
+    memcpy(srv->extradata, data, size);
+    srv->extradata_size = size;
+    pthread_mutex_unlock(&srv->lock);
+}
+
+/*
+* 发布一个编码包
+* 每个客户端队列中放的是同一个包的引用，不复制数据；
+* 客户端队列满时丢掉它的积压并等待下一个关键帧，慢客户端不会拖慢编码也不会无限占用内存
+*/
+void stream_server_publish(struct stream_server* srv, const AVPacket* pkt) {
+    if (!srv->running) return;
+    bool key = pkt->flags & AV_PKT_FLAG_KEY;
+    bool queued = false;
+    pthread_mutex_lock(&srv->lock);
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        struct stream_client* c = &srv->clients[i];
+        if (c->fd < 0 || !c->streaming) continue;
+        if (c->waiting_key) {
+            if (!key) continue;
+            c->waiting_key = false;
+        }
+        if (c->count >= STREAM_CLIENT_QUEUE) {
+            client_drop_all(c);
+            c->dropped++;
+            c->waiting_key = true;   // 丢包后从下一个关键帧恢复
+            continue;
+        }
+        AVPacket* ref = av_packet_clone(pkt);
+        if (!ref) continue;
+        c->queue[(c->head + c->count) % STREAM_CLIENT_QUEUE] = ref;
+        c->count++;
+        queued = true;
+    }
+    pthread_mutex_unlock(&srv->lock);
+    if (queued) {
+        uint64_t one = 1;
+        if (write(srv->wake_fd, &one, sizeof(one)) < 0) { /* 已有未处理的唤醒 */ }
+    }
+}
+
+void stream_server_stop(struct stream_server* srv) {
+    if (!srv->running) return;
+    pthread_mutex_lock(&srv->lock);
+    srv->running = false;
+    pthread_mutex_unlock(&srv->lock);
+    uint64_t one = 1;
+    if (write(srv->wake_fd, &one, sizeof(one)) < 0) { /* 线程1秒内也会自行退出 */ }
+    pthread_join(srv->thread, NULL);
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        client_reset(&srv->clients[i]);
+    }
+    close(srv->wake_fd);
+    close(srv->listen_fd);
+    srv->wake_fd = srv->listen_fd = -1;
+    pthread_mutex_destroy(&srv->lock);
+    fprintf(stderr, "实时流服务已停止\n");
+}
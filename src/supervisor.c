@@ -0,0 +1,153 @@
+#include "supervisor.h"
+
+#define CAMERA_RETRIES  3       // 重新开流的尝试次数（STREAMON偶尔返回EINVAL，稍等后重试可恢复）
+#define CAMERA_RETRY_US 100000  // 每次重试前的等待（逐次加长）
+
+static const char* subsys_names[SV_SUBSYS_NUM] = { "摄像头", "显示", "编码器" };
+
+void supervisor_init(struct supervisor* sv) {
+    if (sv->stall_timeout_ms <= 0) sv->stall_timeout_ms = 1000;
+    if (sv->commit_fail_limit <= 0) sv->commit_fail_limit = 3;
+    if (sv->max_restarts <= 0) sv->max_restarts = 5;
+    if (sv->restart_window_ms <= 0) sv->restart_window_ms = 60000;
+    pthread_mutex_init(&sv->lock, NULL);
+    sv->commit_fails = 0;
+    memset(sv->stat, 0, sizeof(sv->stat));
+}
+
+void supervisor_destroy(struct supervisor* sv) {
+    pthread_mutex_destroy(&sv->lock);
+}
+
+bool supervisor_commit_failed(struct supervisor* sv) {
+    if (++sv->commit_fails < sv->commit_fail_limit) {
+        return false;
+    }
+    sv->commit_fails = 0;
+    return true;
+}
+
+void supervisor_commit_ok(struct supervisor* sv) {
+    sv->commit_fails = 0;
+}
+
+/*
+* 重建限流：窗口内重建次数超过上限说明故障不是偶发的，反复重建没有意义
+* @return: true 允许重建
+*/
+static bool restart_allowed(struct supervisor* sv, enum sv_subsys s, int64_t now) {
+    struct sv_stat* st = &sv->stat[s];
+    if (now - st->window_start_ns >= (int64_t)sv->restart_window_ms * 1000000LL) {
+        st->window_start_ns = now;
+        st->window_count = 0;
+    }
+    if (st->window_count >= sv->max_restarts) {
+        fprintf(stderr, "[恢复] %s %d秒内已重建%d次，放弃\n",
+                subsys_names[s], sv->restart_window_ms / 1000, st->window_count);
+        return false;
+    }
+    st->window_count++;
+    return true;
+}
+
+static int restart_done(struct supervisor* sv, enum sv_subsys s, int64_t t0, int ret) {
+    struct sv_stat* st = &sv->stat[s];
+    int64_t ns = monotonic_ns() - t0;
+    if (ret == 0) {
+        st->restarts++;
+        st->total_ns += ns;
+        if (ns > st->max_ns) st->max_ns = ns;
+        fprintf(stderr, "[恢复] %s已重建，恢复耗时%.1fms\n", subsys_names[s], ns / 1e6);
+    } else {
+        st->failures++;
+        fprintf(stderr, "[恢复] %s重建失败（%.1fms）\n", subsys_names[s], ns / 1e6);
+    }
+    return ret;
+}
+
+// 关流释放缓冲区后重新打开设备，失败时按退避重试
+static int reopen_camera(struct v4l2_capture* cam, const char* dev, uint32_t width, uint32_t height,
+                         unsigned int buffer_count) {
+    v4l2_destroy(cam);
+    int ret = -1;
+    for (int i = 0; i < CAMERA_RETRIES && ret != 0; i++) {
+        if (i > 0) {
+            usleep(CAMERA_RETRY_US * i);
+        }
+        ret = v4l2_init(cam, dev, width, height, buffer_count);
+    }
+    return ret;
+}
+
+/*
+* 重建采集：关流释放缓冲区后重新打开设备
+* 只有主线程访问摄像头，不需要加锁
+*/
+int supervisor_restart_camera(struct supervisor* sv, struct v4l2_capture* cam, const char* dev,
+                              uint32_t width, uint32_t height, unsigned int buffer_count) {
+    int64_t t0 = monotonic_ns();
+    if (!restart_allowed(sv, SV_CAMERA, t0)) {
+        return -1;
+    }
+    int ret = reopen_camera(cam, dev, width, height, buffer_count);
+    return restart_done(sv, SV_CAMERA, t0, ret);
+}
+
+/*
+* 计划内的采集重配置（如调整缓冲区数量）：与重建相同的重试，但不是故障，
+* 不占用重建次数限制，也不计入恢复统计
+*/
+int supervisor_reconfigure_camera(struct supervisor* sv, struct v4l2_capture* cam, const char* dev,
+                                  uint32_t width, uint32_t height, unsigned int buffer_count) {
+    (void)sv;
+    int64_t t0 = monotonic_ns();
+    int ret = reopen_camera(cam, dev, width, height, buffer_count);
+    if (ret == 0) {
+        fprintf(stderr, "[重配] 摄像头已按%u个缓冲区重新开流，耗时%.1fms\n", buffer_count, (monotonic_ns() - t0) / 1e6);
+    } else {
+        fprintf(stderr, "[重配] 摄像头重新开流失败\n");
+    }
+    return ret;
+}
+
+/*
+* 重建显示：释放平面和缓冲区后重新初始化DRM
+* 检测回调会在方框层上绘制，重建期间持锁
+*/
+int supervisor_restart_display(struct supervisor* sv, struct mydisplay* disp) {
+    int64_t t0 = monotonic_ns();
+    if (!restart_allowed(sv, SV_DISPLAY, t0)) {
+        return -1;
+    }
+    pthread_mutex_lock(&sv->lock);
+    mydisplay_destroy(disp);
+    int ret = drm_nv12_init(disp);
+    pthread_mutex_unlock(&sv->lock);
+    return restart_done(sv, SV_DISPLAY, t0, ret);
+}
+
+/*
+* 重建编码器：结束当前分段（写文件尾），重新打开编码器并开始新分段
+* 检测回调会更新编码器的检测结果，重建期间持锁
+*/
+int supervisor_restart_encoder(struct supervisor* sv, VideoEncoder* enc) {
+    int64_t t0 = monotonic_ns();
+    if (!restart_allowed(sv, SV_ENCODER, t0)) {
+        return -1;
+    }
+    pthread_mutex_lock(&sv->lock);
+    video_encoder_release(enc);
+    int ret = video_encoder_init(enc);
+    pthread_mutex_unlock(&sv->lock);
+    return restart_done(sv, SV_ENCODER, t0, ret);
+}
+
+void supervisor_report(struct supervisor* sv) {
+    for (int i = 0; i < SV_SUBSYS_NUM; i++) {
+        struct sv_stat* st = &sv->stat[i];
+        if (st->restarts == 0 && st->failures == 0) continue;
+        printf("[恢复] %s: 重建%llu次 失败%llu次 平均恢复%.1fms 最长%.1fms\n", subsys_names[i],
+               (unsigned long long)st->restarts, (unsigned long long)st->failures,
+               st->restarts ? st->total_ns / 1e6 / st->restarts : 0.0, st->max_ns / 1e6);
+    }
+}
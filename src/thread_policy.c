@@ -0,0 +1,216 @@
+#define _GNU_SOURCE
+#include "thread_policy.h"
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#define MAX_TRACKED_THREADS 16
+
+// 默认策略：显示路径用SCHED_FIFO并独占CPU0，检测等批量任务放到其余核心并降低优先级
+// CPU集合与进程启动时可用的CPU取交集，单核板子上自动退化为不绑核
+// 编码库（x264/FFmpeg）的内部线程不经过这里，它们继承创建者的策略，所以编码器要在thread_policy_suspend之后创建
+static struct thread_policy g_policies[ROLE_NUM] = {
+    [ROLE_CAPTURE] = { "cam_capture", SCHED_FIFO,  50,  0, 0x1 },
+    [ROLE_WRITER]  = { "cam_writer",  SCHED_OTHER,  0,  5, 0x2 },
+    [ROLE_DETECT]  = { "cam_detect",  SCHED_OTHER,  0, 10, 0x2 },
+    [ROLE_LOADER]  = { "cam_loader",  SCHED_OTHER,  0, 10, 0x2 },
+};
+
+// 已登记线程的统计
+struct thread_stat {
+    enum thread_role role;
+    pid_t tid;
+    clockid_t cpu_clock;
+    bool exited;
+    int64_t cpu_ns;            // 退出时记录
+    long nvcsw;                // 主动上下文切换（退出时记录）
+    long nivcsw;               // 被动上下文切换（退出时记录）
+};
+
+static pthread_mutex_t g_stat_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct thread_stat g_stats[MAX_TRACKED_THREADS];
+static int g_stat_count = 0;
+static bool g_memory_locked = false;
+static pthread_once_t g_cpus_once = PTHREAD_ONCE_INIT;
+static cpu_set_t g_process_cpus;       // 进程启动时可用的CPU（线程绑核后sched_getaffinity只返回绑定的核）
+static __thread int t_stat_index = -1;
+static __thread int t_role = -1;       // 当前线程的角色（thread_policy_resume用）
+
+void thread_policy_set(enum thread_role role, const struct thread_policy* policy) {
+    if (role < ROLE_NUM && policy) {
+        g_policies[role] = *policy;
+    }
+}
+
+/*
+* 锁定内存：整个进程只做一次
+* 只锁定已有的映射：MCL_FUTURE会让之后创建的每个线程栈（默认8MB）和库内部的大块分配都立即占满物理内存，
+* 所以要在帧池、缩放帧、编码器、共享内存、显示缓冲区、追踪/分析缓冲区都分配之后调用
+*/
+void thread_policy_lock_memory(void) {
+    pthread_mutex_lock(&g_stat_lock);
+    if (!g_memory_locked) {
+        if (mlockall(MCL_CURRENT) == 0) {
+            fprintf(stderr, "进程内存已锁定\n");
+        } else {
+            perror("mlockall失败(WARN)");
+        }
+        g_memory_locked = true;  // 失败也不再重试
+    }
+    pthread_mutex_unlock(&g_stat_lock);
+}
+
+// 第一次设置策略时（还没有线程绑核）记录进程可用的CPU
+static void read_process_cpus(void) {
+    if (sched_getaffinity(0, sizeof(g_process_cpus), &g_process_cpus) != 0) {
+        CPU_ZERO(&g_process_cpus);
+        CPU_SET(0, &g_process_cpus);
+    }
+}
+
+static void set_affinity(const struct thread_policy* p) {
+    if (p->cpu_mask == 0) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < 32; cpu++) {
+        if ((p->cpu_mask & (1u << cpu)) && CPU_ISSET(cpu, &g_process_cpus)) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    if (CPU_COUNT(&set) == 0) {
+        fprintf(stderr, "线程%s: 配置的CPU不可用，不绑核\n", p->name);
+        return;
+    }
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0) {
+        fprintf(stderr, "线程%s绑核失败: %s\n", p->name, strerror(ret));
+    }
+}
+
+static void set_scheduling(const struct thread_policy* p, pid_t tid) {
+    if (p->policy == SCHED_FIFO || p->policy == SCHED_RR) {
+        struct sched_param param = { .sched_priority = p->rt_priority };
+        int ret = pthread_setschedparam(pthread_self(), p->policy, &param);
+        if (ret == 0) {
+            return;
+        }
+        // 没有CAP_SYS_NICE时退回普通调度，用最高的nice值代替
+        fprintf(stderr, "线程%s设置实时调度失败: %s，改用nice -10\n", p->name, strerror(ret));
+        setpriority(PRIO_PROCESS, tid, -10);
+        return;
+    }
+    // 线程会继承创建者（可能是实时线程）的调度策略，先显式切回普通调度
+    struct sched_param param = { .sched_priority = 0 };
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+    if (setpriority(PRIO_PROCESS, tid, p->nice) != 0) {
+        fprintf(stderr, "线程%s设置nice %d失败: %s\n", p->name, p->nice, strerror(errno));
+    }
+}
+
+/*
+* 按角色设置当前线程
+* 1. 线程命名
+* 2. 绑定CPU
+* 3. 实时调度策略或nice值
+* 4. 登记到统计表
+* @return: 0 成功, -1 参数错误
+*/
+int thread_policy_apply(enum thread_role role) {
+    if (role >= ROLE_NUM) return -1;
+    const struct thread_policy* p = &g_policies[role];
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+
+    pthread_once(&g_cpus_once, read_process_cpus);
+    t_role = role;
+    pthread_setname_np(pthread_self(), p->name);
+    set_affinity(p);
+    set_scheduling(p, tid);
+
+    pthread_mutex_lock(&g_stat_lock);
+    if (t_stat_index < 0 && g_stat_count < MAX_TRACKED_THREADS) {
+        struct thread_stat* st = &g_stats[g_stat_count];
+        memset(st, 0, sizeof(*st));
+        st->role = role;
+        st->tid = tid;
+        if (pthread_getcpuclockid(pthread_self(), &st->cpu_clock) != 0) {
+            st->cpu_clock = CLOCK_THREAD_CPUTIME_ID;
+        }
+        t_stat_index = g_stat_count++;
+    }
+    pthread_mutex_unlock(&g_stat_lock);
+    return 0;
+}
+
+/*
+* 临时切回普通调度并解除绑核
+* 库内部创建的线程继承调用者的调度策略和CPU集合，实时主线程直接创建编码器时，
+* x264的编码线程会以SCHED_FIFO挤在CPU0上和采集抢占
+*/
+void thread_policy_suspend(void) {
+    if (t_role < 0) return;
+    struct sched_param param = { .sched_priority = 0 };
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+    setpriority(PRIO_PROCESS, (pid_t)syscall(SYS_gettid), 0);
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(g_process_cpus), &g_process_cpus);
+    if (ret != 0) {
+        fprintf(stderr, "线程%s解除绑核失败: %s\n", g_policies[t_role].name, strerror(ret));
+    }
+}
+
+void thread_policy_resume(void) {
+    if (t_role < 0) return;
+    const struct thread_policy* p = &g_policies[t_role];
+    set_affinity(p);
+    set_scheduling(p, (pid_t)syscall(SYS_gettid));
+}
+
+void thread_policy_exit(void) {
+    if (t_stat_index < 0) return;
+    struct rusage ru;
+    struct timespec ts;
+    getrusage(RUSAGE_THREAD, &ru);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+    pthread_mutex_lock(&g_stat_lock);
+    struct thread_stat* st = &g_stats[t_stat_index];
+    st->cpu_ns = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    st->nvcsw = ru.ru_nvcsw;
+    st->nivcsw = ru.ru_nivcsw;
+    st->exited = true;
+    pthread_mutex_unlock(&g_stat_lock);
+    t_stat_index = -1;
+}
+
+// 运行中的线程从/proc读取上下文切换次数
+static void read_ctxt_switches(pid_t tid, long* nvcsw, long* nivcsw) {
+    char path[64], line[128];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/status", tid);
+    *nvcsw = *nivcsw = -1;
+    FILE* fp = fopen(path, "r");
+    if (!fp) return;
+    while (fgets(line, sizeof(line), fp)) {
+        sscanf(line, "voluntary_ctxt_switches: %ld", nvcsw);
+        sscanf(line, "nonvoluntary_ctxt_switches: %ld", nivcsw);
+    }
+    fclose(fp);
+}
+
+void thread_policy_report(void) {
+    pthread_mutex_lock(&g_stat_lock);
+    printf("[线程] %-12s %6s %10s %8s %8s\n", "名称", "tid", "CPU时间", "主动切换", "被动切换");
+    for (int i = 0; i < g_stat_count; i++) {
+        struct thread_stat* st = &g_stats[i];
+        int64_t cpu_ns = st->cpu_ns;
+        long nvcsw = st->nvcsw, nivcsw = st->nivcsw;
+        if (!st->exited) {
+            struct timespec ts;
+            if (clock_gettime(st->cpu_clock, &ts) == 0) {
+                cpu_ns = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+            }
+            read_ctxt_switches(st->tid, &nvcsw, &nivcsw);
+        }
+        printf("[线程] %-12s %6d %8.1fms %8ld %8ld%s\n", g_policies[st->role].name, st->tid,
+               cpu_ns / 1e6, nvcsw, nivcsw, st->exited ? " (已退出)" : "");
+    }
+    pthread_mutex_unlock(&g_stat_lock);
+}
@@ -0,0 +1,199 @@
+#define _GNU_SOURCE
+#include "trace.h"
+#include "thread_policy.h"
+#include <sys/syscall.h>
+
+// 一个事件（完整的一段：开始时间 + 时长）
+struct trace_event {
+    const char* name;
+    int64_t start_ns;
+    int64_t end_ns;
+    uint32_t seq;
+};
+
+// 每线程的环：只有所属线程写head，只有写文件线程写tail
+struct trace_ring {
+    int tid;
+    char name[16];
+    uint64_t head;
+    uint64_t tail;
+    uint64_t dropped;        // 环满丢弃的事件数（所属线程写）
+    bool named;              // 线程名元数据已写出（写文件线程使用）
+    struct trace_event ev[TRACE_RING_SIZE];
+};
+
+int trace_on = 0;
+
+static struct {
+    FILE* fp;
+    pthread_t thread;
+    bool running;
+    pthread_mutex_t lock;                         // 保护线程登记
+    pthread_cond_t cond;
+    struct trace_ring* rings[TRACE_MAX_THREADS];
+    int ring_count;                               // 只增不减（写文件线程用原子读）
+    bool first_event;                             // JSON数组中尚无元素
+    uint64_t written;
+    int pid;
+} g_trace = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+static __thread struct trace_ring* tls_ring;
+static __thread bool tls_full;   // 线程数超过上限，本线程不再尝试登记
+
+// 第一次记录时登记本线程的环
+static struct trace_ring* ring_register(void) {
+    if (tls_full) return NULL;
+    struct trace_ring* r = calloc(1, sizeof(*r));
+    if (!r) {
+        tls_full = true;
+        return NULL;
+    }
+    r->tid = (int)syscall(SYS_gettid);
+    pthread_getname_np(pthread_self(), r->name, sizeof(r->name));
+    pthread_mutex_lock(&g_trace.lock);
+    if (g_trace.ring_count < TRACE_MAX_THREADS) {
+        g_trace.rings[g_trace.ring_count] = r;
+        __atomic_store_n(&g_trace.ring_count, g_trace.ring_count + 1, __ATOMIC_RELEASE);
+    } else {
+        free(r);
+        r = NULL;
+        tls_full = true;
+    }
+    pthread_mutex_unlock(&g_trace.lock);
+    tls_ring = r;
+    return r;
+}
+
+void trace_record(const char* name, uint32_t seq, int64_t start_ns, int64_t end_ns) {
+    struct trace_ring* r = tls_ring ? tls_ring : ring_register();
+    if (!r) return;
+    uint64_t head = r->head;
+    if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >= TRACE_RING_SIZE) {
+        r->dropped++;
+        return;
+    }
+    struct trace_event* e = &r->ev[head & (TRACE_RING_SIZE - 1)];
+    e->name = name;
+    e->start_ns = start_ns;
+    e->end_ns = end_ns;
+    e->seq = seq;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static void write_sep(void) {
+    if (!g_trace.first_event) {
+        fputs(",\n", g_trace.fp);
+    }
+    g_trace.first_event = false;
+}
+
+// 取出所有环中的事件写入文件（只在写文件线程和trace_stop中调用）
+static void trace_drain(void) {
+    int n = __atomic_load_n(&g_trace.ring_count, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < n; i++) {
+        struct trace_ring* r = g_trace.rings[i];
+        if (!r->named) {
+            write_sep();
+            fprintf(g_trace.fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    g_trace.pid, r->tid, r->name[0] ? r->name : "thread");
+            r->named = true;
+        }
+        uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        for (uint64_t t = r->tail; t != head; t++) {
+            const struct trace_event* e = &r->ev[t & (TRACE_RING_SIZE - 1)];
+            write_sep();
+            // 时间单位为微秒，保留纳秒精度的小数
+            fprintf(g_trace.fp, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"seq\":%u}}",
+                    e->name, g_trace.pid, r->tid, e->start_ns / 1e3, (e->end_ns - e->start_ns) / 1e3, e->seq);
+            g_trace.written++;
+        }
+        __atomic_store_n(&r->tail, head, __ATOMIC_RELEASE);
+    }
+    fflush(g_trace.fp);
+}
+
+static void* trace_thread(void* arg) {
+    (void)arg;
+    thread_policy_apply(ROLE_WRITER);
+    pthread_mutex_lock(&g_trace.lock);
+    while (g_trace.running) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += TRACE_FLUSH_MS * 1000000L;
+        ts.tv_sec += ts.tv_nsec / 1000000000L;
+        ts.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&g_trace.cond, &g_trace.lock, &ts);
+        pthread_mutex_unlock(&g_trace.lock);
+        trace_drain();
+        pthread_mutex_lock(&g_trace.lock);
+    }
+    pthread_mutex_unlock(&g_trace.lock);
+    thread_policy_exit();
+    return NULL;
+}
+
+int trace_start(const char* path, bool enabled) {
+    if (g_trace.fp) return 0;
+    g_trace.fp = fopen(path, "w");
+    if (!g_trace.fp) {
+        perror("打开追踪文件失败");
+        return -1;
+    }
+    g_trace.pid = getpid();
+    g_trace.first_event = true;
+    g_trace.written = 0;
+    fputs("[\n", g_trace.fp);
+    g_trace.running = true;
+    if (pthread_create(&g_trace.thread, NULL, trace_thread, NULL)) {
+        fprintf(stderr, "无法创建追踪写文件线程\n");
+        g_trace.running = false;
+        fclose(g_trace.fp);
+        g_trace.fp = NULL;
+        return -1;
+    }
+    trace_set_enabled(enabled);
+    fprintf(stderr, "追踪输出: %s（%s）\n", path, enabled ? "已开启" : "未开启");
+    return 0;
+}
+
+void trace_set_enabled(bool enabled) {
+    if (!g_trace.fp) return;
+    __atomic_store_n(&trace_on, enabled ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+static void toggle_handler(int signo) {
+    (void)signo;
+    if (!g_trace.fp) return;
+    __atomic_xor_fetch(&trace_on, 1, __ATOMIC_RELAXED);   // 信号处理中只改标志
+}
+
+void trace_toggle_on_signal(int signo) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = toggle_handler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(signo, &sa, NULL);
+}
+
+void trace_stop(void) {
+    if (!g_trace.fp) return;
+    __atomic_store_n(&trace_on, 0, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&g_trace.lock);
+    g_trace.running = false;
+    pthread_cond_signal(&g_trace.cond);
+    pthread_mutex_unlock(&g_trace.lock);
+    pthread_join(g_trace.thread, NULL);
+    trace_drain();
+    fputs("\n]\n", g_trace.fp);
+    fclose(g_trace.fp);
+    g_trace.fp = NULL;
+
+    uint64_t dropped = 0;
+    for (int i = 0; i < g_trace.ring_count; i++) {
+        dropped += g_trace.rings[i]->dropped;
+    }
+    // 环保留到进程退出：其他线程可能仍持有自己的环指针
+    fprintf(stderr, "追踪: 写出%llu段 %d个线程 环满丢弃%llu段\n", (unsigned long long)g_trace.written,
+            g_trace.ring_count, (unsigned long long)dropped);
+}
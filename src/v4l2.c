@@ -1,4 +1,76 @@
 #include "v4l2.h"   
+#include <poll.h>
+
+/*
+* 文件源初始化：帧按全局时间格（CLOCK_MONOTONIC按帧间隔取整）产生，
+* 同帧率的多个文件源时间戳完全一致，可以用来测试按时间戳配对
+* @return: 0 成功, -1 失败
+*/
+static int file_source_init(struct v4l2_capture *vcap, const char *dev, uint32_t buffer_count) {
+    vcap->is_file = true;
+    vcap->pitch = vcap->width;
+    vcap->uv_offset = vcap->width * vcap->height;
+    vcap->frame_bytes = (size_t)vcap->width * vcap->height * 3 / 2;
+    if ((vcap->fd = open(dev, O_RDONLY | O_CLOEXEC)) < 0) {
+        perror("打开帧文件失败");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(vcap->fd, &st) < 0 || (size_t)st.st_size < vcap->frame_bytes) {
+        fprintf(stderr, "帧文件%s不足一帧(%ux%u NV12)\n", dev, vcap->width, vcap->height);
+        goto error;
+    }
+    vcap->file_frames = st.st_size / vcap->frame_bytes;
+    if (!(vcap->buffers = calloc(buffer_count, sizeof(struct buffer)))) {
+        perror("采集缓冲区记录结构体的内存分配失败");
+        goto error;
+    }
+    for (vcap->n_buffers = 0; vcap->n_buffers < buffer_count; vcap->n_buffers++) {
+        vcap->buffers[vcap->n_buffers].length = vcap->frame_bytes;
+        vcap->buffers[vcap->n_buffers].start = malloc(vcap->frame_bytes);
+        if (!vcap->buffers[vcap->n_buffers].start) {
+            perror("帧缓冲区分配失败");
+            goto error;
+        }
+    }
+    vcap->period_ns = 1000000000LL / (vcap->file_fps > 0 ? vcap->file_fps : 30);
+    vcap->start_tick = monotonic_ns() / vcap->period_ns;
+    vcap->last_tick = vcap->start_tick - 1;
+    fprintf(stderr, "文件源%s: %ux%u %llu帧 %lldfps\n", dev, vcap->width, vcap->height,
+            (unsigned long long)vcap->file_frames, 1000000000LL / vcap->period_ns);
+    return 0;
+
+error:
+    v4l2_destroy(vcap);
+    return -1;
+}
+
+// 文件源出队：和驱动一样最多积压n_buffers帧，按顺序取；积压满时跳过更早的帧（序号照常递增）
+static int file_source_dequeue(struct v4l2_capture *vcap, struct v4l2_buffer *buf, struct frame_meta *meta) {
+    int64_t now_tick = monotonic_ns() / vcap->period_ns;
+    if (now_tick <= vcap->last_tick) {
+        return 1;
+    }
+    int64_t tick = vcap->last_tick + 1;
+    if (now_tick - tick >= (int64_t)vcap->n_buffers) {
+        tick = now_tick - vcap->n_buffers + 1;
+    }
+    vcap->last_tick = tick;
+    uint64_t seq = tick - vcap->start_tick;
+    buf->index = seq % vcap->n_buffers;
+    buf->sequence = (uint32_t)seq;
+    struct buffer *b = &vcap->buffers[buf->index];
+    off_t offset = (off_t)(seq % vcap->file_frames) * vcap->frame_bytes;
+    if (pread(vcap->fd, b->start, vcap->frame_bytes, offset) != (ssize_t)vcap->frame_bytes) {
+        perror("读取帧文件失败");
+        return -1;
+    }
+    if (meta) {
+        meta->sequence = buf->sequence;
+        meta->capture_ns = tick * vcap->period_ns;
+    }
+    return 0;
+}
 
 /*
 * V4L2摄像头初始化
@@ -18,6 +90,12 @@ int v4l2_init(struct v4l2_capture *vcap, const char *dev, uint32_t width, uint32
     vcap->height = height; // 
     vcap->fd = -1;         // 初始化文件描述符为-1
     vcap->buffers = NULL;  // 初始化缓冲区指针为NULL
+    vcap->is_file = false;
+
+    struct stat st;
+    if (stat(dev, &st) == 0 && S_ISREG(st.st_mode)) {
+        return file_source_init(vcap, dev, buffer_count);
+    }
 
     // 1、获得设备文件描述符 
     if ((vcap->fd = open(dev, O_RDWR)) < 0) {
@@ -56,8 +134,16 @@ int v4l2_init(struct v4l2_capture *vcap, const char *dev, uint32_t width, uint32
             (fmt.fmt.pix.pixelformat >> 8) & 0xFF,
             (fmt.fmt.pix.pixelformat >> 16) & 0xFF,
             (fmt.fmt.pix.pixelformat >> 24) & 0xFF);
-    vcap->pitch = fmt.fmt.pix.bytesperline;// 更新行步长，用于后期解码
+    // 单平面NV12：UV紧跟在Y平面（pitch * height）之后，行步长可能带硬件对齐
+    vcap->pitch = fmt.fmt.pix.bytesperline ? fmt.fmt.pix.bytesperline : vcap->width;
+    vcap->uv_offset = vcap->pitch * vcap->height;
     fprintf(stderr, "摄像头行步长: %u bytes\n", vcap->pitch);
+    if (fmt.fmt.pix.width != vcap->width || fmt.fmt.pix.height != vcap->height ||
+        fmt.fmt.pix.pixelformat != V4L2_PIX_FMT_NV12 || vcap->pitch < vcap->width ||
+        (fmt.fmt.pix.sizeimage && fmt.fmt.pix.sizeimage < vcap->uv_offset + vcap->pitch * vcap->height / 2)) {
+        fprintf(stderr, "驱动给出的格式与请求不一致\n");
+        goto error;
+    }
 
     // 有问题
     struct v4l2_streamparm parm;
@@ -157,8 +243,10 @@ stream_error:
     }
 buffer_error:
     free(vcap->buffers);  // 释放记录采集缓冲区的结构体内存
+    vcap->buffers = NULL;
 error:
     close(vcap->fd);  // 关闭设备文件描述符
+    vcap->fd = -1;    // 失败后v4l2_destroy/重新初始化不会再操作已关闭的描述符
     return -1;
 }
 
@@ -168,6 +256,18 @@ error:
 */
 void v4l2_destroy(struct v4l2_capture *vcap) {
     if (!vcap || vcap->fd == -1) return;
+    if (vcap->is_file) {
+        if (vcap->buffers) {
+            for (unsigned int i = 0; i < vcap->n_buffers; i++) {
+                free(vcap->buffers[i].start);
+            }
+            free(vcap->buffers);
+            vcap->buffers = NULL;
+        }
+        close(vcap->fd);
+        vcap->fd = -1;
+        return;
+    }
     enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE; // 定义缓冲区类型
     ioctl(vcap->fd, VIDIOC_STREAMOFF, &type); // 停止视频流
     fprintf(stderr, "视频流已停止\n");
@@ -182,4 +282,103 @@ void v4l2_destroy(struct v4l2_capture *vcap) {
     close(vcap->fd); // 关闭设备文件描述符
     vcap->fd = -1;
     fprintf(stderr, "摄像头设备已关闭\n");
-}
\ No newline at end of file
+}
+/*
+* 等待下一帧就绪（设备以阻塞方式打开，直接DQBUF在传感器卡死时会永远等下去）
+* @timeout_ms: 超时时间
+* @return: 0 有帧可出队, 1 超时, -1 失败
+*/
+int v4l2_wait(struct v4l2_capture *vcap, int timeout_ms) {
+    if (vcap->is_file) {
+        // 文件源：睡到下一个时间格
+        int64_t due = (vcap->last_tick + 1) * vcap->period_ns;
+        int64_t wait = due - monotonic_ns();
+        if (wait > (int64_t)timeout_ms * 1000000LL) {
+            usleep(timeout_ms * 1000);
+            return 1;
+        }
+        if (wait > 0) {
+            struct timespec ts = { due / 1000000000LL, due % 1000000000LL };
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+        }
+        return 0;
+    }
+    struct pollfd pfd = { .fd = vcap->fd, .events = POLLIN };
+    int ret;
+    do {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+        perror("等待采集帧失败");
+        return -1;
+    }
+    if (ret == 0) {
+        return 1;
+    }
+    if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        fprintf(stderr, "采集设备异常(revents=0x%x)\n", pfd.revents);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+* 出队一帧
+* @buf: 输出，出队的缓冲区信息（用于之后重新入队）
+* @meta: 输出，帧序号与采集时间戳
+* @return: 0 成功, 1 暂无数据(EAGAIN), -1 失败
+*/
+int v4l2_dequeue(struct v4l2_capture *vcap, struct v4l2_buffer *buf, struct frame_meta *meta) {
+    CLEAR(*buf);
+    buf->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf->memory = V4L2_MEMORY_MMAP;
+    if (vcap->is_file) {
+        return file_source_dequeue(vcap, buf, meta);
+    }
+    if (ioctl(vcap->fd, VIDIOC_DQBUF, buf) < 0) {
+        if (errno == EAGAIN) {
+            return 1;
+        }
+        perror("出队失败");
+        return -1;
+    }
+    if (meta) {
+        meta->sequence = buf->sequence;
+        // 驱动给出单调时钟时间戳时直接使用，否则以出队时间近似
+        if ((buf->flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC &&
+            (buf->timestamp.tv_sec || buf->timestamp.tv_usec)) {
+            meta->capture_ns = (int64_t)buf->timestamp.tv_sec * 1000000000LL +
+                               (int64_t)buf->timestamp.tv_usec * 1000;
+        } else {
+            meta->capture_ns = monotonic_ns();
+        }
+    }
+    return 0;
+}
+
+/*
+* 缓冲区重新入队
+* @return: 0 成功, -1 失败
+*/
+int v4l2_requeue(struct v4l2_capture *vcap, struct v4l2_buffer *buf) {
+    if (vcap->is_file) {
+        return 0;  // 文件源的缓冲区按序号轮流使用
+    }
+    if (ioctl(vcap->fd, VIDIOC_QBUF, buf) < 0) {
+        perror("入队失败");
+        return -1;
+    }
+    return 0;
+}
+
+// 出队缓冲区的帧描述：消费方按pitch/uv_offset访问，不需要先重排成紧凑格式
+void v4l2_frame(const struct v4l2_capture *vcap, const struct v4l2_buffer *buf,
+                const struct frame_meta *meta, struct frame_desc *frame) {
+    const struct buffer *b = &vcap->buffers[buf->index];
+    *frame = frame_desc_nv12((uint8_t*)b->start, vcap->width, vcap->height, vcap->pitch, vcap->uv_offset);
+    frame->size = b->length;
+    frame->handle = buf->index;
+    if (meta) {
+        frame->meta = *meta;
+    }
+}
@@ -0,0 +1,68 @@
+#include "yolo_decoder.h"
+
+#define V5_ANCHORS 3   // YOLOv5每个输出头的锚框数
+
+// 注册表：常用的类别数做编译期特化，其余走通用版本（num_classes = 0）
+#define V5_ENTRY(T, code, nc)  { HeadFormat::AnchorV5, nc, code, decode_anchor_v5<T, nc, V5_ANCHORS>, "yolov5/" #T "/nc" #nc }
+#define V8_ENTRY(T, code, nc)  { HeadFormat::AnchorFreeV8, nc, code, decode_anchor_free_v8<T, nc>, "yolov8/" #T "/nc" #nc }
+
+static const DecoderEntry g_decoders[] = {
+    V5_ENTRY(float, dt_float32, 1), V5_ENTRY(int8_t, dt_int8, 1), V5_ENTRY(uint8_t, dt_uint8, 1),
+    V5_ENTRY(float, dt_float32, 80), V5_ENTRY(int8_t, dt_int8, 80), V5_ENTRY(uint8_t, dt_uint8, 80),
+    V5_ENTRY(float, dt_float32, 0), V5_ENTRY(int8_t, dt_int8, 0), V5_ENTRY(uint8_t, dt_uint8, 0),
+    V8_ENTRY(float, dt_float32, 1), V8_ENTRY(int8_t, dt_int8, 1), V8_ENTRY(uint8_t, dt_uint8, 1),
+    V8_ENTRY(float, dt_float32, 80), V8_ENTRY(int8_t, dt_int8, 80), V8_ENTRY(uint8_t, dt_uint8, 80),
+    V8_ENTRY(float, dt_float32, 0), V8_ENTRY(int8_t, dt_int8, 0), V8_ENTRY(uint8_t, dt_uint8, 0),
+};
+
+bool detect_head_format(const std::vector<std::vector<int>> &output_shapes, HeadFormat &format, int &num_classes)
+{
+    // YOLOv5: 3个 [1, H, W, 3*(5+nc)]
+    if (output_shapes.size() == 3)
+    {
+        int channels = output_shapes[0].back();
+        for (const auto &shape : output_shapes)
+        {
+            if (shape.size() != 4 || shape.back() != channels)
+            {
+                return false;
+            }
+        }
+        if (channels % V5_ANCHORS != 0 || channels / V5_ANCHORS <= 5)
+        {
+            return false;
+        }
+        format = HeadFormat::AnchorV5;
+        num_classes = channels / V5_ANCHORS - 5;
+        return true;
+    }
+    // YOLOv8: 1个 [1, 4+nc, N]
+    if (output_shapes.size() == 1 && output_shapes[0].size() == 3 && output_shapes[0][1] > 4)
+    {
+        format = HeadFormat::AnchorFreeV8;
+        num_classes = output_shapes[0][1] - 4;
+        return true;
+    }
+    return false;
+}
+
+const DecoderEntry *select_decoder(HeadFormat format, int num_classes, typecode_t type)
+{
+    const DecoderEntry *generic = nullptr;
+    for (const auto &e : g_decoders)
+    {
+        if (e.format != format || e.type != type)
+        {
+            continue;
+        }
+        if (e.num_classes == num_classes)
+        {
+            return &e;
+        }
+        if (e.num_classes == 0)
+        {
+            generic = &e;
+        }
+    }
+    return generic;
+}
@@ -0,0 +1,229 @@
+#include "zone.h"
+
+// 解析一行："名称 include|exclude 得分阈值 最小重叠 x1,y1 x2,y2 ..."
+static int parse_zone(struct zone* z, const char* line) {
+    char type[16];
+    int n = 0;
+    memset(z, 0, sizeof(*z));
+    if (sscanf(line, "%31s %15s %f %f %n", z->name, type, &z->min_score, &z->min_overlap, &n) != 4) {
+        return -1;
+    }
+    if (strcmp(type, "exclude") == 0) {
+        z->exclude = true;
+    } else if (strcmp(type, "include") != 0) {
+        return -1;
+    }
+    const char* p = line + n;
+    float x, y;
+    int used;
+    while (sscanf(p, " %f,%f%n", &x, &y, &used) == 2) {
+        if (z->npoints == ZONE_MAX_POINTS) {
+            return -1;
+        }
+        z->points[z->npoints][0] = x;
+        z->points[z->npoints][1] = y;
+        z->npoints++;
+        p += used;
+    }
+    return z->npoints >= 3 ? 0 : -1;
+}
+
+static int cmp_float(const void* a, const void* b) {
+    float fa = *(const float*)a, fb = *(const float*)b;
+    return (fa > fb) - (fa < fb);
+}
+
+/*
+* 扫描线栅格化（奇偶规则）：格子中心落在多边形内即算在区域内
+*/
+static void rasterize(struct zone_map* zm, int index) {
+    const struct zone* z = &zm->zones[index];
+    float xs[ZONE_MAX_POINTS];
+    for (int gy = 0; gy < zm->grid_h; gy++) {
+        float y = (gy + 0.5f) * zm->cell / zm->height;
+        int nx = 0;
+        for (int i = 0, j = z->npoints - 1; i < z->npoints; j = i++) {
+            float yi = z->points[i][1], yj = z->points[j][1];
+            if ((yi > y) != (yj > y)) {
+                xs[nx++] = z->points[i][0] + (y - yi) * (z->points[j][0] - z->points[i][0]) / (yj - yi);
+            }
+        }
+        qsort(xs, nx, sizeof(float), cmp_float);
+        uint8_t* row = zm->mask + (size_t)gy * zm->grid_w;
+        for (int k = 0; k + 1 < nx; k += 2) {
+            int gx0 = (int)ceilf(xs[k] * zm->width / zm->cell - 0.5f);
+            int gx1 = (int)ceilf(xs[k + 1] * zm->width / zm->cell - 0.5f);
+            if (gx0 < 0) gx0 = 0;
+            if (gx1 > zm->grid_w) gx1 = zm->grid_w;
+            for (int gx = gx0; gx < gx1; gx++) {
+                row[gx] |= 1u << index;
+            }
+        }
+    }
+}
+
+static void build_integral(struct zone_map* zm, int index) {
+    uint32_t* in = zm->integral[index];
+    int stride = zm->grid_w + 1;
+    memset(in, 0, stride * sizeof(uint32_t));
+    for (int gy = 0; gy < zm->grid_h; gy++) {
+        const uint8_t* row = zm->mask + (size_t)gy * zm->grid_w;
+        uint32_t* prev = in + (size_t)gy * stride;
+        uint32_t* cur = prev + stride;
+        uint32_t run = 0;
+        cur[0] = 0;
+        for (int gx = 0; gx < zm->grid_w; gx++) {
+            run += (row[gx] >> index) & 1;
+            cur[gx + 1] = prev[gx + 1] + run;
+        }
+    }
+}
+
+/*
+* 加载并栅格化区域
+* @width/@height: 检测框坐标所在的分辨率
+* @cell: 栅格大小（像素），越大位图越小，边界越粗
+* @return: 0 成功, -1 失败
+*/
+int zone_map_load(struct zone_map* zm, const char* path, int width, int height, int cell) {
+    memset(zm, 0, sizeof(*zm));
+    if (width <= 0 || height <= 0 || cell <= 0) {
+        return -1;
+    }
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        perror("打开区域配置失败");
+        return -1;
+    }
+    zm->width = width;
+    zm->height = height;
+    zm->cell = cell;
+    zm->grid_w = (width + cell - 1) / cell;
+    zm->grid_h = (height + cell - 1) / cell;
+
+    char line[512];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char* p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\0') {
+            continue;
+        }
+        if (zm->count == ZONE_MAX) {
+            fprintf(stderr, "区域数超过%d，忽略第%d行之后的区域\n", ZONE_MAX, lineno);
+            break;
+        }
+        if (parse_zone(&zm->zones[zm->count], p) != 0) {
+            fprintf(stderr, "区域配置第%d行格式错误\n", lineno);
+            goto error;
+        }
+        if (zm->zones[zm->count].exclude) {
+            zm->exclude_bits |= 1u << zm->count;
+        } else {
+            zm->include_count++;
+        }
+        zm->count++;
+    }
+    fclose(fp);
+    fp = NULL;
+
+    zm->mask = calloc((size_t)zm->grid_w * zm->grid_h, 1);
+    if (!zm->mask) {
+        perror("区域位图分配失败");
+        goto error;
+    }
+    for (int i = 0; i < zm->count; i++) {
+        zm->integral[i] = malloc((size_t)(zm->grid_w + 1) * (zm->grid_h + 1) * sizeof(uint32_t));
+        if (!zm->integral[i]) {
+            perror("区域积分图分配失败");
+            goto error;
+        }
+        rasterize(zm, i);
+        build_integral(zm, i);
+        const struct zone* z = &zm->zones[i];
+        fprintf(stderr, "区域 %s: %s 阈值%.2f 重叠%.2f %d个顶点\n", z->name,
+                z->exclude ? "排除" : "检测", z->min_score, z->min_overlap, z->npoints);
+    }
+    return 0;
+
+error:
+    if (fp) fclose(fp);
+    zone_map_free(zm);
+    return -1;
+}
+
+void zone_map_free(struct zone_map* zm) {
+    free(zm->mask);
+    zm->mask = NULL;
+    for (int i = 0; i < ZONE_MAX; i++) {
+        free(zm->integral[i]);
+        zm->integral[i] = NULL;
+    }
+    zm->count = 0;
+    zm->include_count = 0;
+    zm->exclude_bits = 0;
+}
+
+float zone_map_min_score(const struct zone_map* zm, float default_thresh) {
+    float t = default_thresh;
+    if (!zm) return t;
+    for (int i = 0; i < zm->count; i++) {
+        if (!zm->zones[i].exclude && zm->zones[i].min_score < t) {
+            t = zm->zones[i].min_score;
+        }
+    }
+    return t;
+}
+
+/*
+* 框与各区域的重叠比例由积分图四次查表得到，与框大小无关
+* 排除区优先；有包含区时框至少要满足一个包含区的重叠和得分要求；没有包含区时按全局阈值
+*/
+bool zone_map_accept(const struct zone_map* zm, float x1, float y1, float x2, float y2, float score, float default_thresh) {
+    if (!zm || zm->count == 0) {
+        return score >= default_thresh;
+    }
+    int gx1 = (int)floorf(x1 / zm->cell), gy1 = (int)floorf(y1 / zm->cell);
+    int gx2 = (int)ceilf(x2 / zm->cell), gy2 = (int)ceilf(y2 / zm->cell);
+    if (gx1 < 0) gx1 = 0;
+    if (gy1 < 0) gy1 = 0;
+    if (gx2 > zm->grid_w) gx2 = zm->grid_w;
+    if (gy2 > zm->grid_h) gy2 = zm->grid_h;
+    if (gx2 <= gx1 || gy2 <= gy1) {
+        return zm->include_count == 0 && score >= default_thresh;
+    }
+    float area = (float)(gx2 - gx1) * (gy2 - gy1);
+    int stride = zm->grid_w + 1;
+
+    bool included = false;
+    for (int i = 0; i < zm->count; i++) {
+        const uint32_t* in = zm->integral[i];
+        uint32_t sum = in[gy2 * stride + gx2] - in[gy1 * stride + gx2]
+                     - in[gy2 * stride + gx1] + in[gy1 * stride + gx1];
+        if (sum == 0) continue;
+        const struct zone* z = &zm->zones[i];
+        float cover = sum / area;
+        if (cover < z->min_overlap) continue;
+        if (z->exclude) {
+            return false;
+        }
+        if (score >= z->min_score) {
+            included = true;
+        }
+    }
+    if (zm->include_count > 0) {
+        return included;
+    }
+    return score >= default_thresh;
+}
+
+bool zone_map_ignored(const struct zone_map* zm, int x, int y) {
+    if (!zm || zm->count == 0 || x < 0 || y < 0 || x >= zm->width || y >= zm->height) {
+        return false;
+    }
+    uint8_t bits = zm->mask[(y / zm->cell) * zm->grid_w + x / zm->cell];
+    if (bits & zm->exclude_bits) {
+        return true;
+    }
+    return zm->include_count > 0 && !bits;
+}
@@ -0,0 +1,133 @@
+// 解码器主机测试：合成量化输出张量，比较int8/uint8解码与float解码的检测框
+// float输入取量化值反量化后的结果，两条路径的得分和坐标算式相同，检测框必须完全一致（量化域门限不能多丢或多留）
+// 编译运行：make decoder_test && ./decoder_test（主机g++，只编译yolo_decoder.cpp，不依赖SDK和nncase）
+#include "yolo_decoder.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+static const float g_anchors[3][3][2] = {
+    { { 10, 13 }, { 16, 30 }, { 33, 23 } },
+    { { 30, 61 }, { 62, 45 }, { 59, 119 } },
+    { { 116, 90 }, { 156, 198 }, { 373, 326 } },
+};
+static const int g_strides[3] = { 8, 16, 32 };
+
+#define NET_W 320
+#define NET_H 192
+#define V8_BOXES 1260   // (40*24 + 20*12 + 10*6)
+
+static uint32_t g_seed = 12345;
+
+static uint32_t rnd() {
+    g_seed = g_seed * 1664525u + 1013904223u;
+    return g_seed >> 8;
+}
+
+// 大部分取值偏低（像真实输出一样多数候选远低于阈值），少部分在整个量化范围内均匀分布
+template <typename T>
+static T rnd_q() {
+    int lo = std::numeric_limits<T>::min(), hi = std::numeric_limits<T>::max();
+    int span = hi - lo + 1;
+    int v = (rnd() % 8 == 0) ? lo + (int)(rnd() % span) : lo + (int)(rnd() % (span / 4));
+    return (T)v;
+}
+
+static bool same_boxes(const std::vector<BoxInfo> &a, const std::vector<BoxInfo> &b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].x1 != b[i].x1 || a[i].y1 != b[i].y1 || a[i].x2 != b[i].x2 || a[i].y2 != b[i].y2 ||
+            a[i].score != b[i].score || a[i].label != b[i].label) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Head {
+    HeadDesc desc;
+    size_t count;   // 元素个数
+};
+
+static std::vector<Head> make_heads(HeadFormat format, int nc) {
+    std::vector<Head> heads;
+    if (format == HeadFormat::AnchorV5) {
+        for (int i = 0; i < 3; i++) {
+            HeadDesc d = { g_strides[i], NET_W / g_strides[i], NET_H / g_strides[i], g_anchors[i], 0 };
+            heads.push_back({ d, (size_t)d.grid_w * d.grid_h * 3 * (5 + nc) });
+        }
+    } else {
+        HeadDesc d = { 0, 0, 0, nullptr, V8_BOXES };
+        heads.push_back({ d, (size_t)(4 + nc) * V8_BOXES });
+    }
+    return heads;
+}
+
+/*
+* 一组用例：同一份量化数据分别按量化类型和float解码
+* 阈值取若干个正好落在量化格点上的值（score == 阈值时两条路径都必须丢弃）和格点之间的值
+* @return: 不一致的用例数
+*/
+template <typename T>
+static int run_case(HeadFormat format, int nc, typecode_t type, float scale, int zero_point) {
+    HeadQuant q = { type, scale, zero_point };
+    HeadQuant qf = { dt_float32, 1.f, 0 };
+    const DecoderEntry *dq = select_decoder(format, nc, type);
+    const DecoderEntry *df = select_decoder(format, nc, dt_float32);
+    if (!dq || !df) {
+        printf("没有可用的解码器: nc=%d\n", nc);
+        return 1;
+    }
+
+    std::vector<Head> heads = make_heads(format, nc);
+    std::vector<std::vector<T>> qdata(heads.size());
+    std::vector<std::vector<float>> fdata(heads.size());
+    for (size_t h = 0; h < heads.size(); h++) {
+        qdata[h].resize(heads[h].count);
+        fdata[h].resize(heads[h].count);
+        for (size_t i = 0; i < heads[h].count; i++) {
+            qdata[h][i] = rnd_q<T>();
+            fdata[h][i] = QuantTraits<T>::value(qdata[h][i], q);
+        }
+    }
+
+    int failed = 0;
+    int levels[] = { 40, 90, 140, 200 };   // 相对量化下限的格点
+    for (int li = 0; li < 4; li++) {
+        for (int between = 0; between < 2; between++) {
+            float thr = QuantTraits<T>::value((T)(std::numeric_limits<T>::min() + levels[li]), q);
+            if (format == HeadFormat::AnchorV5) {
+                thr = thr * thr;   // v5得分为 cls * obj
+            }
+            if (between) {
+                thr += scale * 0.37f;
+            }
+            DecodeParams p = { NET_W, NET_H, nc, { 1280, 720 }, thr, make_letterbox(NET_W, NET_H, 1280, 720) };
+            std::vector<BoxInfo> bq, bf;
+            for (size_t h = 0; h < heads.size(); h++) {
+                dq->fn(qdata[h].data(), q, heads[h].desc, p, bq);
+                df->fn(fdata[h].data(), qf, heads[h].desc, p, bf);
+            }
+            bool ok = same_boxes(bq, bf);
+            printf("%-22s 阈值%.5f: 量化%zu框 float%zu框 %s\n", dq->name, thr, bq.size(), bf.size(),
+                   ok ? "一致" : "不一致");
+            failed += !ok;
+        }
+    }
+    return failed;
+}
+
+int main() {
+    int failed = 0;
+    const int classes[] = { 1, 80, 3 };   // 1、80为编译期特化，3走通用版本
+    for (int nc : classes) {
+        failed += run_case<int8_t>(HeadFormat::AnchorV5, nc, dt_int8, 1.f / 255, -128);
+        failed += run_case<int8_t>(HeadFormat::AnchorV5, nc, dt_int8, 1.f / 200, -100);
+        failed += run_case<uint8_t>(HeadFormat::AnchorV5, nc, dt_uint8, 1.f / 255, 0);
+        failed += run_case<uint8_t>(HeadFormat::AnchorV5, nc, dt_uint8, 1.f / 230, 12);
+        failed += run_case<int8_t>(HeadFormat::AnchorFreeV8, nc, dt_int8, 1.f / 255, -128);
+        failed += run_case<uint8_t>(HeadFormat::AnchorFreeV8, nc, dt_uint8, 1.f / 230, 12);
+    }
+    printf("%s: %d个用例不一致\n", failed ? "失败" : "通过", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,337 @@
+// 图片行人检测：单张图片检测后画框另存；批量模式遍历目录/列表，输出JSON行并统计吞吐与各阶段耗时
+// 图片编解码和画框用OpenCV，这是工程中唯一依赖OpenCV的程序（camera的视频通路不链接OpenCV）
+#include "person_detect.h"
+#include <opencv2/opencv.hpp>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+static void usage(const char* prog) {
+    fprintf(stderr, "用法: %s [-m kmodel] [-c 检测框阈值] [-n NMS阈值]\n", prog);
+    fprintf(stderr, "  单张: [-i 输入图片] [-o 输出图片]\n");
+    fprintf(stderr, "  批量: -d 目录 | -l 文件列表  [-j 解码线程数] [-q 预取深度] [-J 结果文件(JSON行，默认标准输出)]\n");
+}
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// BGR交织 -> 平面BGR（ai2d输入为CHW）
+static void bgr_to_chw(const cv::Mat& img, std::vector<uint8_t>& chw) {
+    size_t plane = (size_t)img.rows * img.cols;
+    chw.resize(plane * 3);
+    for (int y = 0; y < img.rows; y++) {
+        const uint8_t* src = img.ptr<uint8_t>(y);
+        size_t o = (size_t)y * img.cols;
+        for (int x = 0; x < img.cols; x++) {
+            chw[o + x] = src[x * 3];
+            chw[plane + o + x] = src[x * 3 + 1];
+            chw[plane * 2 + o + x] = src[x * 3 + 2];
+        }
+    }
+}
+
+// 单张图片：检测并画框另存
+static int detect_one(personDetect& pd, const char* input, const char* output) {
+    cv::Mat ori_img = cv::imread(input);
+    if (ori_img.empty()) {
+        fprintf(stderr, "Error: Failed to load image %s\n", input);
+        return -1;
+    }
+    std::vector<uint8_t> chw;
+    bgr_to_chw(ori_img, chw);
+    pd.pre_process({3, (size_t)ori_img.rows, (size_t)ori_img.cols}, chw);
+    pd.inference();
+
+    std::vector<BoxInfo> results;
+    pd.post_process({(size_t)ori_img.cols, (size_t)ori_img.rows}, results);
+
+    // 绘制检测结果
+    for (const auto& r : results) {
+        const std::string text = pd.labels[0] + ":" + std::to_string(r.score).substr(0, 4);
+        cv::rectangle(ori_img,
+                     cv::Rect(cv::Point(r.x1, r.y1), cv::Point(r.x2, r.y2)),
+                     cv::Scalar(0, 0, 255), 2);
+        cv::putText(ori_img, text,
+                   cv::Point(r.x1, r.y1 - 5),
+                   cv::FONT_HERSHEY_SIMPLEX, 0.5,
+                   cv::Scalar(0, 255, 255), 1);
+    }
+    fprintf(stderr, "Detected %zu persons\n", results.size());
+    cv::imwrite(output, ori_img);
+    return 0;
+}
+
+// 批量模式------------------------------------------------------------------
+
+enum bench_stage { ST_DECODE = 0, ST_PRE, ST_INFER, ST_POST, ST_NUM };
+static const char* stage_names[ST_NUM] = { "解码", "预处理", "推理", "后处理" };
+
+// 一张解码好的图片（解码线程 -> 检测线程）
+struct image_job {
+    size_t index;
+    std::string path;
+    int width = 0, height = 0;
+    std::vector<uint8_t> chw;   // 为空表示解码失败
+    int64_t decode_ns = 0;
+};
+
+// 有界队列：解码线程最多领先检测预取深度张，内存占用固定
+class image_queue {
+public:
+    explicit image_queue(size_t depth) : depth_(depth) {}
+    void push(image_job* job) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return jobs_.size() < depth_; });
+        jobs_.push_back(job);
+        not_empty_.notify_one();
+    }
+    image_job* pop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return !jobs_.empty() || producers_ == 0; });
+        if (jobs_.empty()) return nullptr;
+        image_job* job = jobs_.front();
+        jobs_.pop_front();
+        not_full_.notify_one();
+        return job;
+    }
+    void add_producer() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        producers_++;
+    }
+    void producer_done() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        producers_--;
+        not_empty_.notify_all();
+    }
+private:
+    std::mutex mutex_;
+    std::condition_variable not_full_, not_empty_;
+    std::deque<image_job*> jobs_;
+    size_t depth_;
+    int producers_ = 0;
+};
+
+static bool is_image(const std::string& name) {
+    size_t dot = name.find_last_of('.');
+    if (dot == std::string::npos) return false;
+    std::string ext = name.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == "jpg" || ext == "jpeg" || ext == "png" || ext == "bmp";
+}
+
+// 递归收集目录下的图片
+static void collect_dir(const std::string& dir, std::vector<std::string>& files) {
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        perror(dir.c_str());
+        return;
+    }
+    while (struct dirent* e = readdir(d)) {
+        if (e->d_name[0] == '.') continue;
+        std::string path = dir + "/" + e->d_name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            collect_dir(path, files);
+        } else if (S_ISREG(st.st_mode) && is_image(e->d_name)) {
+            files.push_back(path);
+        }
+    }
+    closedir(d);
+}
+
+static int collect_list(const char* list, std::vector<std::string>& files) {
+    std::ifstream f(list);
+    if (!f) {
+        perror(list);
+        return -1;
+    }
+    std::string line;
+    while (std::getline(f, line)) {
+        if (!line.empty() && line[0] != '#') {
+            files.push_back(line);
+        }
+    }
+    return 0;
+}
+
+// 解码线程：按原子计数领取文件，解码并转成CHW后放入预取队列
+static void decode_worker(const std::vector<std::string>* files, std::atomic<size_t>* next, image_queue* q) {
+    for (size_t i = (*next)++; i < files->size(); i = (*next)++) {
+        image_job* job = new image_job;
+        job->index = i;
+        job->path = (*files)[i];
+        int64_t t0 = now_ns();
+        cv::Mat img = cv::imread(job->path);
+        if (!img.empty()) {
+            job->width = img.cols;
+            job->height = img.rows;
+            bgr_to_chw(img, job->chw);
+        }
+        job->decode_ns = now_ns() - t0;
+        q->push(job);
+    }
+    q->producer_done();
+}
+
+static double percentile_ms(std::vector<int64_t>& v, double p) {
+    if (v.empty()) return 0.0;
+    size_t k = (size_t)(p * (v.size() - 1) + 0.5);
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k] / 1e6;
+}
+
+// JSON字符串转义（文件名中可能有引号、反斜杠）
+static std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+static int detect_batch(personDetect& pd, std::vector<std::string>& files, int workers, int depth, FILE* out) {
+    if (files.empty()) {
+        fprintf(stderr, "没有找到图片\n");
+        return -1;
+    }
+    image_queue q(depth);
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < workers; i++) {
+        q.add_producer();
+        threads.emplace_back(decode_worker, &files, &next, &q);
+    }
+
+    std::vector<int64_t> lat[ST_NUM];
+    size_t done = 0, failed = 0, boxes = 0;
+    int64_t t_start = now_ns();
+    while (image_job* job = q.pop()) {
+        if (job->chw.empty()) {
+            fprintf(stderr, "解码失败: %s\n", job->path.c_str());
+            failed++;
+            delete job;
+            continue;
+        }
+        std::vector<BoxInfo> results;
+        int64_t t0 = now_ns();
+        pd.pre_process({3, (size_t)job->height, (size_t)job->width}, job->chw);
+        int64_t t1 = now_ns();
+        pd.inference();
+        int64_t t2 = now_ns();
+        pd.post_process({(size_t)job->width, (size_t)job->height}, results);
+        int64_t t3 = now_ns();
+        lat[ST_DECODE].push_back(job->decode_ns);
+        lat[ST_PRE].push_back(t1 - t0);
+        lat[ST_INFER].push_back(t2 - t1);
+        lat[ST_POST].push_back(t3 - t2);
+
+        fprintf(out, "{\"file\":\"%s\",\"width\":%d,\"height\":%d,\"boxes\":[",
+                json_escape(job->path).c_str(), job->width, job->height);
+        for (size_t i = 0; i < results.size(); i++) {
+            const BoxInfo& b = results[i];
+            fprintf(out, "%s{\"label\":%d,\"score\":%.4f,\"x1\":%.1f,\"y1\":%.1f,\"x2\":%.1f,\"y2\":%.1f}",
+                    i ? "," : "", b.label, b.score, b.x1, b.y1, b.x2, b.y2);
+        }
+        fprintf(out, "]}\n");
+        boxes += results.size();
+        done++;
+        delete job;
+    }
+    double seconds = (now_ns() - t_start) / 1e9;
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    fprintf(stderr, "批量检测: %zu张 失败%zu张 %zu个框 %.2f秒 %.1f张/秒（解码线程%d 预取%d）\n",
+            done, failed, boxes, seconds, seconds > 0 ? done / seconds : 0.0, workers, depth);
+    for (int s = 0; s < ST_NUM; s++) {
+        std::vector<int64_t>& v = lat[s];
+        if (v.empty()) continue;
+        int64_t sum = 0;
+        for (int64_t x : v) sum += x;
+        fprintf(stderr, "  %s: 平均%.2fms p50=%.2fms p90=%.2fms p99=%.2fms 最大%.2fms\n", stage_names[s],
+                sum / 1e6 / v.size(), percentile_ms(v, 0.5), percentile_ms(v, 0.9),
+                percentile_ms(v, 0.99), percentile_ms(v, 1.0));
+    }
+    return failed == files.size() ? -1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* model_path = "./model/person_detect_yolov5n.kmodel";
+    const char* input = "./frame_result.jpg";
+    const char* output = "pd_result.jpg";
+    const char* dir = nullptr;
+    const char* list = nullptr;
+    const char* json = nullptr;
+    int workers = 2, depth = 8;
+    float conf_threshold = 0.5f, nms_threshold = 0.3f;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:i:o:c:n:d:l:j:q:J:h")) != -1) {
+        switch (opt) {
+            case 'm': model_path = optarg; break;
+            case 'i': input = optarg; break;
+            case 'o': output = optarg; break;
+            case 'c': conf_threshold = atof(optarg); break;
+            case 'n': nms_threshold = atof(optarg); break;
+            case 'd': dir = optarg; break;
+            case 'l': list = optarg; break;
+            case 'j': workers = atoi(optarg); break;
+            case 'q': depth = atoi(optarg); break;
+            case 'J': json = optarg; break;
+            default: usage(argv[0]); return EXIT_FAILURE;
+        }
+    }
+    if (workers < 1) workers = 1;
+    if (depth < 1) depth = 1;
+
+    std::vector<std::string> files;
+    if (dir) {
+        collect_dir(dir, files);
+        std::sort(files.begin(), files.end());
+    }
+    if (list && collect_list(list, files) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    int ret;
+    try {
+        personDetect pd(model_path, conf_threshold, nms_threshold, 0);
+        if (dir || list) {
+            FILE* out = json ? fopen(json, "w") : stdout;
+            if (!out) {
+                perror(json);
+                return EXIT_FAILURE;
+            }
+            ret = detect_batch(pd, files, workers, depth, out);
+            if (out != stdout) fclose(out);
+        } else {
+            ret = detect_one(pd, input, output);
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
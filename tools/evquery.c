@@ -0,0 +1,220 @@
+// 录像事件查询工具：列出有人出现的时间段，按时间从最近的关键帧剪辑片段（直接拷贝分片，不解码）
+// 编译：make evquery（也可以在电脑上 gcc -Iinclude tools/evquery.c src/event_index.c -o evquery）
+#define _GNU_SOURCE
+#include "event_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+#define EVENT_GAP_INTERVALS 2   // 相邻检测汇总间隔不超过N个周期时合并为一个事件
+#define COPY_BUFFER (256 * 1024)
+
+static void format_time(char* out, size_t size, int64_t realtime_ms) {
+    time_t t = realtime_ms / 1000;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    strftime(out, size, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+static void print_event(const char* name, const struct event_index_header* hdr,
+                        int64_t start_ms, int64_t end_ms, const struct event_index_record* peak,
+                        const int16_t box[4]) {
+    char when[32];
+    format_time(when, sizeof(when), hdr->start_realtime_ms + start_ms);
+    printf("%s  %s  +%.1fs  持续%.1fs  最多%d人  最高%.2f  范围(%d,%d)-(%d,%d)\n",
+           name, when, start_ms / 1000.0, (end_ms - start_ms) / 1000.0,
+           peak->count, peak->max_score / 1000.0, box[0], box[1], box[2], box[3]);
+}
+
+// 列出一个索引中的事件：相邻的检测汇总合并，每个事件给出起止时间、人数、得分和框的并集
+static int list_events(const char* dir, const char* name, float min_score) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    struct event_index idx;
+    if (event_index_map(&idx, path) != 0) {
+        return -1;
+    }
+    char media[256];
+    snprintf(media, sizeof(media), "%.*s.mp4", (int)(strlen(name) - strlen(EVENT_INDEX_SUFFIX)), name);
+
+    int events = 0;
+    int open = 0;
+    int64_t start_ms = 0, end_ms = 0;
+    struct event_index_record peak;
+    int16_t box[4];
+    int64_t gap = (int64_t)idx.header->interval_ms * EVENT_GAP_INTERVALS;
+    for (size_t i = 0; i < idx.count; i++) {
+        const struct event_index_record* r = &idx.records[i];
+        if (r->type != EVENT_DETECT || r->max_score < min_score * 1000) continue;
+        int64_t r_start = r->pts_ms - r->duration_ms;
+        if (open && r_start - end_ms > gap) {
+            print_event(media, idx.header, start_ms, end_ms, &peak, box);
+            events++;
+            open = 0;
+        }
+        if (!open) {
+            open = 1;
+            start_ms = r_start;
+            peak = *r;
+            memcpy(box, r->box, sizeof(box));
+        } else {
+            if (r->count > peak.count) peak.count = r->count;
+            if (r->max_score > peak.max_score) peak.max_score = r->max_score;
+            if (r->box[0] < box[0]) box[0] = r->box[0];
+            if (r->box[1] < box[1]) box[1] = r->box[1];
+            if (r->box[2] > box[2]) box[2] = r->box[2];
+            if (r->box[3] > box[3]) box[3] = r->box[3];
+        }
+        end_ms = r->pts_ms;
+    }
+    if (open) {
+        print_event(media, idx.header, start_ms, end_ms, &peak, box);
+        events++;
+    }
+    event_index_unmap(&idx);
+    return events;
+}
+
+static int name_cmp(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static int list_dir(const char* dir, float min_score) {
+    DIR* d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "无法打开目录%s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    char** names = NULL;
+    size_t count = 0, cap = 0;
+    size_t suffix_len = strlen(EVENT_INDEX_SUFFIX);
+    struct dirent* de;
+    while ((de = readdir(d)) != NULL) {
+        size_t len = strlen(de->d_name);
+        if (len <= suffix_len || strcmp(de->d_name + len - suffix_len, EVENT_INDEX_SUFFIX) != 0) continue;
+        if (count == cap) {
+            cap = cap ? cap * 2 : 64;
+            char** grown = realloc(names, cap * sizeof(*names));
+            if (!grown) break;
+            names = grown;
+        }
+        names[count++] = strdup(de->d_name);
+    }
+    closedir(d);
+    qsort(names, count, sizeof(*names), name_cmp);   // 文件名带时间，按名字即按时间
+    int total = 0;
+    for (size_t i = 0; i < count; i++) {
+        int n = list_events(dir, names[i], min_score);
+        if (n > 0) total += n;
+        free(names[i]);
+    }
+    free(names);
+    printf("共%d个事件\n", total);
+    return 0;
+}
+
+static int copy_range(int in, int out, uint64_t from, uint64_t to) {
+    static char buf[COPY_BUFFER];
+    while (from < to) {
+        size_t want = to - from < sizeof(buf) ? to - from : sizeof(buf);
+        ssize_t n = pread(in, buf, want, from);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return n == 0 ? 0 : -1;   // 文件比索引短（录像仍在写入）时拷到末尾为止
+        }
+        if (write(out, buf, n) != n) return -1;
+        from += n;
+    }
+    return 0;
+}
+
+/*
+* 剪辑片段
+* 分片MP4 = 初始化段（ftyp+moov，到第一个分片为止）+ 若干独立分片，
+* 取初始化段 + [起点所在关键帧的分片, 终点之后第一个关键帧的分片) 拼接即为可播放的文件
+*/
+static int extract_clip(const char* media, double start_s, double length_s, const char* output) {
+    char path[512];
+    event_index_path(path, sizeof(path), media);
+    struct event_index idx;
+    if (event_index_map(&idx, path) != 0) {
+        fprintf(stderr, "无法读取事件索引%s\n", path);
+        return -1;
+    }
+    int ret = -1;
+    int in = -1, out = -1;
+    int64_t start_ms = (int64_t)(start_s * 1000);
+    int64_t end_ms = start_ms + (int64_t)(length_s * 1000);
+    const struct event_index_record* first = event_index_keyframe_after(&idx, 0);
+    const struct event_index_record* from = event_index_keyframe_at(&idx, start_ms);
+    const struct event_index_record* to = event_index_keyframe_after(&idx, end_ms + 1);
+    if (!first) {
+        fprintf(stderr, "索引中没有关键帧\n");
+        goto cleanup;
+    }
+    if (!from) from = first;
+
+    in = open(media, O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        fprintf(stderr, "无法打开%s: %s\n", media, strerror(errno));
+        goto cleanup;
+    }
+    struct stat st;
+    fstat(in, &st);
+    uint64_t end_offset = to ? to->offset : (uint64_t)st.st_size;
+    out = open(output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        fprintf(stderr, "无法创建%s: %s\n", output, strerror(errno));
+        goto cleanup;
+    }
+    if (copy_range(in, out, 0, first->offset) != 0 ||
+        copy_range(in, out, from->offset, end_offset) != 0) {
+        fprintf(stderr, "剪辑写入失败: %s\n", strerror(errno));
+        goto cleanup;
+    }
+    printf("已剪辑 %s: +%.1fs ~ %s (%llu bytes)\n", output, from->pts_ms / 1000.0,
+           to ? "下一个关键帧" : "文件末尾",
+           (unsigned long long)(first->offset + end_offset - from->offset));
+    ret = 0;
+cleanup:
+    if (in >= 0) close(in);
+    if (out >= 0) close(out);
+    event_index_unmap(&idx);
+    return ret;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "用法: %s [-d 目录] [-m 最低得分]              列出事件\n", prog);
+    fprintf(stderr, "      %s -x 录像.mp4 -s 秒 -l 秒 -o 输出.mp4   剪辑片段\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    const char* dir = "./video";
+    const char* clip = NULL;
+    const char* output = "clip.mp4";
+    double start_s = 0, length_s = 10;
+    float min_score = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:m:x:s:l:o:h")) != -1) {
+        switch (opt) {
+            case 'd': dir = optarg; break;
+            case 'm': min_score = atof(optarg); break;
+            case 'x': clip = optarg; break;
+            case 's': start_s = atof(optarg); break;
+            case 'l': length_s = atof(optarg); break;
+            case 'o': output = optarg; break;
+            default: usage(argv[0]); return EXIT_FAILURE;
+        }
+    }
+    if (clip) {
+        return extract_clip(clip, start_s, length_s, output) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    return list_dir(dir, min_score) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,69 @@
+// 共享内存读者示例：统计收到的帧率、跳帧，打印最新检测结果（零拷贝读取，只计算Y平面均值作为示意）
+// 编译：make shmview
+#include "shm_ring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int main(int argc, char* argv[]) {
+    const char* name = "/k230_pipeline";
+    int seconds = 10;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:h")) != -1) {
+        switch (opt) {
+            case 'n': name = optarg; break;
+            case 't': seconds = atoi(optarg); break;
+            default:
+                fprintf(stderr, "用法: %s [-n 共享内存名] [-t 秒]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    struct shm_reader rd;
+    if (shm_reader_open(&rd, name) != 0) {
+        return EXIT_FAILURE;
+    }
+    printf("已连接 %s: %ux%u, %u帧槽, 生产者pid %u\n", name, rd.header->width, rd.header->height,
+           rd.header->frame_slots, rd.header->producer_pid);
+
+    uint64_t frames = 0;
+    int64_t latency_sum = 0;
+    int64_t start = now_ns(), last_print = start;
+    while (now_ns() - start < (int64_t)seconds * 1000000000LL) {
+        struct shm_frame_view view;
+        if (shm_reader_next_frame(&rd, &view)) {
+            uint64_t sum = 0;
+            for (uint32_t i = 0; i < rd.header->width * rd.header->height; i += 64) {
+                sum += view.nv12[i];
+            }
+            if (shm_reader_frame_valid(&rd, &view)) {   // 用完后确认期间没有被覆盖
+                frames++;
+                latency_sum += now_ns() - view.capture_ns;
+            }
+            (void)sum;
+        } else {
+            usleep(2000);
+        }
+        struct shm_det_slot det;
+        if (shm_reader_latest_detections(&rd, &det) && det.count > 0) {
+            printf("帧%u: %u人, 首个(%d,%d)-(%d,%d) %.2f\n", det.sequence, det.count,
+                   det.boxes[0].x1, det.boxes[0].y1, det.boxes[0].x2, det.boxes[0].y2, det.boxes[0].score);
+        }
+        if (now_ns() - last_print >= 1000000000LL) {
+            printf("收到%llu帧 跳过%llu 覆盖%llu 平均延迟%.1fms\n", (unsigned long long)frames,
+                   (unsigned long long)rd.skipped, (unsigned long long)rd.torn,
+                   frames ? latency_sum / 1e6 / frames : 0.0);
+            last_print = now_ns();
+        }
+    }
+    shm_reader_close(&rd);
+    return EXIT_SUCCESS;
+}